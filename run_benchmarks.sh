@@ -165,7 +165,11 @@ build_c() {
 build_cpp() {
     print_header "Building C++ benchmark"
     if [ "$CPP_AVAILABLE" = true ]; then
-        if run_with_error_handling g++ -O3 -std=c++17 src/cpp/cpp_test.cpp -o bin/cpp_test -pthread; then
+        # Standard parallel algorithms need TBB under libstdc++; without it they run serially
+        if g++ -O3 -std=c++20 -DBENCH_PARALLEL_STL src/cpp/cpp_test.cpp -o bin/cpp_test -pthread -ltbb 2>/dev/null; then
+            status "C++ benchmark built successfully (parallel STL via TBB)"
+            return 0
+        elif run_with_error_handling g++ -O3 -std=c++20 src/cpp/cpp_test.cpp -o bin/cpp_test -pthread; then
             status "C++ benchmark built successfully"
             return 0
         else
@@ -178,6 +182,23 @@ build_cpp() {
     fi
 }
 
+# Build C++ benchmark with the OpenMP backend compiled in
+build_cpp_omp() {
+    print_header "Building C++ OpenMP benchmark"
+    if [ "$CPP_AVAILABLE" = true ]; then
+        if run_with_error_handling g++ -O3 -std=c++20 -fopenmp src/cpp/cpp_test.cpp -o bin/cpp_test_omp -pthread; then
+            status "C++ OpenMP benchmark built successfully"
+            return 0
+        else
+            error "C++ OpenMP benchmark build failed"
+            return 1
+        fi
+    else
+        error "Skipping C++ OpenMP benchmark build"
+        return 1
+    fi
+}
+
 # Build C MPI benchmark
 build_c_mpi() {
     print_header "Building C MPI benchmark"
@@ -199,7 +220,11 @@ build_c_mpi() {
 build_cpp_mpi() {
     print_header "Building C++ MPI benchmark"
     if [ "$CPP_AVAILABLE" = true ] && [ "$MPI_AVAILABLE" = true ]; then
-        if run_with_error_handling mpicxx -O3 -std=c++17 src/cpp/cpp_test_mpi.cpp -o bin/cpp_test_mpi; then
+        # The PMPI profiling layer is linked in front of MPI; it stays idle unless
+        # --mpi-profile PATH is given
+        if run_with_error_handling mpicxx -O3 -std=c++17 -c src/cpp/mpi_profile.cpp -o bin/mpi_profile.o &&
+           run_with_error_handling ar rcs bin/libmpi_profile.a bin/mpi_profile.o &&
+           run_with_error_handling mpicxx -O3 -std=c++17 src/cpp/cpp_test_mpi.cpp -o bin/cpp_test_mpi -Lbin -lmpi_profile; then
             status "C++ MPI benchmark built successfully"
             return 0
         else
@@ -318,6 +343,23 @@ run_cpp() {
     fi
 }
 
+# Run C++ benchmark on the OpenMP backend
+run_cpp_omp() {
+    print_header "Running C++ OpenMP benchmark"
+    if [ -f bin/cpp_test_omp ]; then
+        if run_with_error_handling bin/cpp_test_omp $THREADS --backend openmp; then
+            status "C++ OpenMP benchmark completed"
+            return 0
+        else
+            error "C++ OpenMP benchmark failed during execution"
+            return 1
+        fi
+    else
+        error "C++ OpenMP executable not found. Build may have failed."
+        return 1
+    fi
+}
+
 # Run C MPI benchmark
 run_c_mpi() {
     print_header "Running C MPI benchmark"
@@ -448,7 +490,7 @@ print_usage() {
     echo "Run the entire benchmark suite or a specific benchmark with the specified number of threads."
     echo ""
     echo "Arguments:"
-    echo "  benchmark   Optional: Specific benchmark to run (c, cpp, c_mpi, cpp_mpi, go, rust, java, python)"
+    echo "  benchmark   Optional: Specific benchmark to run (c, cpp, cpp_omp, c_mpi, cpp_mpi, go, rust, java, python)"
     echo "  threads     Optional: Number of threads to use (default: all available)"
     echo ""
     echo "Examples:"
@@ -475,6 +517,11 @@ run_benchmark() {
                 run_cpp && success=true
             fi
             ;;
+        cpp_omp)
+            if build_cpp_omp; then
+                run_cpp_omp && success=true
+            fi
+            ;;
         c_mpi)
             if build_c_mpi; then
                 run_c_mpi && success=true
@@ -554,6 +601,18 @@ run_all_benchmarks() {
     fi
     ((total_count++))
     
+    # Build and run C++ on the OpenMP backend
+    if build_cpp_omp; then
+        if run_cpp_omp; then
+            ((success_count++))
+        else
+            failed_benchmarks+=("C++ OpenMP (runtime)")
+        fi
+    else
+        failed_benchmarks+=("C++ OpenMP (build)")
+    fi
+    ((total_count++))
+    
     # Build and run C MPI if available
     if [ "$MPI_AVAILABLE" = true ]; then
         if build_c_mpi; then
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+#include <string>
+
+#include "bench_results.hpp"
+
+// Heap allocation accounting for the benchmark kernels.
+//
+// This header replaces the global operator new/delete, so it must be included by exactly one
+// translation unit: the benchmark's main file. Every block carries a small size header so
+// frees can be subtracted from the live total, which gives peak usage per kernel.
+
+inline std::atomic<size_t> g_alloc_bytes{0};
+inline std::atomic<size_t> g_alloc_count{0};
+inline std::atomic<size_t> g_alloc_live{0};
+inline std::atomic<size_t> g_alloc_peak{0};
+
+// Allocation totals since construction, e.g. around one kernel call. Constructing a scope
+// restarts the peak measurement, so scopes should not overlap.
+class AllocScope {
+public:
+    AllocScope()
+        : bytes_(g_alloc_bytes.load()), count_(g_alloc_count.load()), live_(g_alloc_live.load()) {
+        g_alloc_peak.store(live_);
+    }
+
+    size_t bytes() const { return g_alloc_bytes.load() - bytes_; }
+    size_t count() const { return g_alloc_count.load() - count_; }
+
+    // Highest live heap usage above the level at construction
+    size_t peak() const { return g_alloc_peak.load() - live_; }
+
+private:
+    size_t bytes_;
+    size_t count_;
+    size_t live_;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const AllocScope& scope) {
+    return out << scope.count() << " allocations, " << scope.bytes() << " bytes, peak "
+               << scope.peak() << " bytes";
+}
+
+// Appends "<name>_alloc_count", "<name>_bytes_allocated" and "<name>_alloc_peak_bytes"
+inline void record_allocations(ResultList& results, const char* name, const AllocScope& scope) {
+    // Read the totals before building the keys, which allocate themselves
+    size_t count = scope.count();
+    size_t bytes = scope.bytes();
+    size_t peak = scope.peak();
+    results.emplace_back(std::string(name) + "_alloc_count", count);
+    results.emplace_back(std::string(name) + "_bytes_allocated", bytes);
+    results.emplace_back(std::string(name) + "_alloc_peak_bytes", peak);
+}
+
+// Header in front of each block holding its size; at least 16 bytes so the default new
+// alignment is kept, or the requested alignment for over-aligned allocations
+constexpr size_t kAllocHeader = 16;
+
+inline void* tracked_alloc(size_t size, size_t alignment = kAllocHeader) {
+    size_t header = std::max(kAllocHeader, alignment);
+    size_t total = (size + header + alignment - 1) / alignment * alignment;
+    void* block = alignment > kAllocHeader ? std::aligned_alloc(alignment, total)
+                                           : std::malloc(size + header);
+    if (!block) throw std::bad_alloc();
+    char* p = static_cast<char*>(block) + header;
+    *reinterpret_cast<size_t*>(p - sizeof(size_t)) = size;
+
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    size_t live = g_alloc_live.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = g_alloc_peak.load(std::memory_order_relaxed);
+    while (live > peak && !g_alloc_peak.compare_exchange_weak(peak, live)) {
+    }
+    return p;
+}
+
+// Out of line on purpose: once operator delete is inlined into a caller that got the block
+// from operator new, GCC sees free() on a pointer from new and warns (-Wmismatched-new-delete),
+// not knowing that both operators are these replacements
+[[gnu::noinline]] inline void release_block(void* block) {
+    std::free(block);
+}
+
+inline void tracked_free(void* ptr, size_t alignment = kAllocHeader) {
+    if (!ptr) return;
+    char* p = static_cast<char*>(ptr);
+    g_alloc_live.fetch_sub(*reinterpret_cast<size_t*>(p - sizeof(size_t)),
+                           std::memory_order_relaxed);
+    release_block(p - std::max(kAllocHeader, alignment));
+}
+
+void* operator new(size_t size) {
+    return tracked_alloc(size);
+}
+
+void* operator new[](size_t size) {
+    return tracked_alloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return tracked_alloc(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return tracked_alloc(size, static_cast<size_t>(alignment));
+}
+
+// The nothrow forms (std::get_temporary_buffer, used by std::inplace_merge, allocates with
+// them) go through the tracker too, so every block is freed by the allocator that made it
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return tracked_alloc(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return tracked_alloc(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try {
+        return tracked_alloc(size, static_cast<size_t>(alignment));
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try {
+        return tracked_alloc(size, static_cast<size_t>(alignment));
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* p) noexcept {
+    tracked_free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    tracked_free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    tracked_free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    tracked_free(p);
+}
+
+void operator delete(void* p, std::align_val_t alignment) noexcept {
+    tracked_free(p, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* p, std::align_val_t alignment) noexcept {
+    tracked_free(p, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept {
+    tracked_free(p, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept {
+    tracked_free(p, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    tracked_free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    tracked_free(p);
+}
+
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    tracked_free(p, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    tracked_free(p, static_cast<size_t>(alignment));
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Arena plumbing for the benchmark kernels.
+//
+// Kernels take a std::pmr::memory_resource* for their scratch and result buffers. Passing a
+// KernelArena turns every allocation into a pointer bump in a buffer that was allocated (and
+// faulted in) before timing started, so the measured time is algorithm cost only; passing
+// the default resource gives the usual malloc/free behaviour.
+
+class KernelArena : public std::pmr::memory_resource {
+public:
+    explicit KernelArena(size_t bytes) {
+        grow(bytes);
+    }
+
+    // Reclaims everything handed out since the last reset; memory from before a reset must
+    // no longer be used. If the buffer overflowed, it is enlarged to the high-water mark so
+    // the next round fits without touching the heap.
+    void reset() {
+        if (overflow_.bytes > 0) {
+            size_t needed = buffer_.size() + overflow_.bytes;
+            arena_.reset();
+            grow(needed);
+        } else {
+            arena_->release();
+        }
+    }
+
+    size_t capacity() const { return buffer_.size(); }
+
+private:
+    // Upstream for the monotonic resource that records how far the buffer overflowed
+    class OverflowCounter : public std::pmr::memory_resource {
+    public:
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t size, size_t alignment) override {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, alignment);
+        }
+        void do_deallocate(void* p, size_t size, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    void* do_allocate(size_t size, size_t alignment) override {
+        return arena_->allocate(size, alignment);
+    }
+
+    // Individual frees are no-ops, as in any monotonic resource
+    void do_deallocate(void*, size_t, size_t) override {
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    void grow(size_t bytes) {
+        buffer_.assign(bytes, std::byte{0}); // zero-filled, so every page is faulted in now
+        overflow_.bytes = 0;
+        arena_ = std::make_unique<std::pmr::monotonic_buffer_resource>(
+            buffer_.data(), buffer_.size(), &overflow_);
+    }
+
+    std::vector<std::byte> buffer_;
+    OverflowCounter overflow_;
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena_;
+};
+
+// The calling thread's arena, created with `initial_bytes` on first use
+inline KernelArena& thread_arena(size_t initial_bytes = size_t(64) << 20) {
+    thread_local KernelArena arena(initial_bytes);
+    return arena;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+
+// Minimal command line helpers shared by the C++ benchmarks.
+// Options are given as "--name value" or "--name=value"; anything else is positional.
+
+inline bool is_option(const char* arg) {
+    return std::strncmp(arg, "--", 2) == 0;
+}
+
+// Returns the value of option `name`, or `fallback` if it was not given
+inline std::string get_option(int argc, char* argv[], const std::string& name,
+                              const std::string& fallback = "") {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == name && i + 1 < argc) {
+            return argv[i + 1];
+        }
+        if (arg.size() > name.size() && arg.compare(0, name.size(), name) == 0 &&
+            arg[name.size()] == '=') {
+            return arg.substr(name.size() + 1);
+        }
+    }
+    return fallback;
+}
+
+// Returns true if the bare flag `name` is present
+inline bool has_flag(int argc, char* argv[], const std::string& name) {
+    for (int i = 1; i < argc; i++) {
+        if (name == argv[i]) return true;
+    }
+    return false;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Binary container for benchmark inputs and outputs that can be mapped back without copying.
+//
+// A file is a 64-byte header followed by the raw elements in host byte order, so the payload
+// starts 64-byte aligned in the mapping. The header records the element type and count, the
+// seed the data was generated from (0 if none) and a checksum. The checksum is a sum of mixed
+// elements: it does not depend on element order, so a sorted output must match its input, and
+// slices (threads, MPI ranks) can be checksummed separately and added up. A file is only
+// marked complete once it is sealed, so a half-written one is never read back as valid.
+
+enum class DatasetType : uint32_t { Int32 = 1, Int64 = 2, UInt64 = 3, Float64 = 4 };
+
+template <typename T>
+constexpr DatasetType dataset_type() {
+    if constexpr (std::is_same_v<T, int32_t>) return DatasetType::Int32;
+    else if constexpr (std::is_same_v<T, int64_t>) return DatasetType::Int64;
+    else if constexpr (std::is_same_v<T, uint64_t>) return DatasetType::UInt64;
+    else {
+        static_assert(std::is_same_v<T, double>, "unsupported dataset element type");
+        return DatasetType::Float64;
+    }
+}
+
+struct DatasetHeader {
+    uint64_t magic;
+    uint32_t version;
+    DatasetType type;
+    uint64_t count;
+    uint64_t seed;
+    uint64_t checksum;
+    uint64_t complete;
+    uint64_t reserved[2];
+};
+static_assert(sizeof(DatasetHeader) == 64, "dataset payload must start 64-byte aligned");
+
+constexpr uint64_t kDatasetMagic = 0x3153544144484342; // "BCHDATS1"
+constexpr uint32_t kDatasetVersion = 1;
+
+// Order-independent checksum of count elements, split across threads
+template <typename T>
+uint64_t dataset_checksum(const T* data, size_t count, unsigned num_threads = 1) {
+    auto checksum_range = [data](size_t begin, size_t end) {
+        uint64_t sum = 0;
+        for (size_t i = begin; i < end; i++) {
+            uint64_t z = 0;
+            std::memcpy(&z, &data[i], sizeof(T));
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            sum += z ^ (z >> 31);
+        }
+        return sum;
+    };
+    num_threads = std::max(1u, num_threads);
+    size_t chunk = (count + num_threads - 1) / num_threads;
+    if (num_threads == 1 || chunk == 0) return checksum_range(0, count);
+    std::vector<std::future<uint64_t>> futures;
+    for (size_t begin = 0; begin < count; begin += chunk) {
+        futures.push_back(std::async(std::launch::async, checksum_range, begin,
+                                     std::min(count, begin + chunk)));
+    }
+    uint64_t sum = 0;
+    for (auto& future : futures) {
+        sum += future.get();
+    }
+    return sum;
+}
+
+// A dataset file mapped into memory. Opening maps an existing file read-only (or writable);
+// creating sizes a new file for `count` elements, to be filled through data() and sealed.
+template <typename T>
+class MappedDataset {
+public:
+    explicit MappedDataset(const std::string& path, bool writable = false) {
+        open_file(path, writable ? O_RDWR : O_RDONLY);
+        struct stat st;
+        fstat(fd_, &st);
+        if (static_cast<size_t>(st.st_size) < sizeof(DatasetHeader)) {
+            close_file();
+            throw std::runtime_error("dataset: " + path + " is too short");
+        }
+        map(static_cast<size_t>(st.st_size), writable);
+        const DatasetHeader& h = header();
+        const char* problem = nullptr;
+        if (h.magic != kDatasetMagic || h.version != kDatasetVersion) {
+            problem = " is not a dataset file";
+        } else if (h.type != dataset_type<T>()) {
+            problem = " holds another element type";
+        } else if (h.count > (bytes_ - sizeof(DatasetHeader)) / sizeof(T)) {
+            problem = " is truncated";
+        } else if (!h.complete && !writable) {
+            problem = " was never sealed";
+        }
+        if (problem) {
+            unmap();
+            throw std::runtime_error("dataset: " + path + problem);
+        }
+    }
+
+    MappedDataset(const std::string& path, size_t count, uint64_t seed) {
+        open_file(path, O_RDWR | O_CREAT | O_TRUNC);
+        size_t bytes = sizeof(DatasetHeader) + count * sizeof(T);
+        if (ftruncate(fd_, bytes) != 0) {
+            close_file();
+            throw std::runtime_error("dataset: cannot size " + path);
+        }
+        map(bytes, true);
+        header() = DatasetHeader{kDatasetMagic, kDatasetVersion, dataset_type<T>(), count, seed,
+                                 0, 0, {}};
+    }
+
+    ~MappedDataset() { unmap(); }
+
+    MappedDataset(MappedDataset&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1)), base_(std::exchange(other.base_, nullptr)),
+          bytes_(std::exchange(other.bytes_, 0)) {}
+    MappedDataset& operator=(MappedDataset&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            fd_ = std::exchange(other.fd_, -1);
+            base_ = std::exchange(other.base_, nullptr);
+            bytes_ = std::exchange(other.bytes_, 0);
+        }
+        return *this;
+    }
+    MappedDataset(const MappedDataset&) = delete;
+    MappedDataset& operator=(const MappedDataset&) = delete;
+
+    T* data() { return reinterpret_cast<T*>(base_ + sizeof(DatasetHeader)); }
+    const T* data() const { return reinterpret_cast<const T*>(base_ + sizeof(DatasetHeader)); }
+    size_t size() const { return header().count; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+    uint64_t seed() const { return header().seed; }
+    uint64_t checksum() const { return header().checksum; }
+    bool complete() const { return header().complete != 0; }
+
+    // Records the checksum of the (now fully written) payload and marks the file complete
+    void seal(uint64_t checksum) {
+        msync(base_, bytes_, MS_SYNC);
+        header().checksum = checksum;
+        header().complete = 1;
+        msync(base_, sizeof(DatasetHeader), MS_SYNC);
+    }
+
+    // Recomputes the payload checksum and compares it with the header
+    bool verify(unsigned num_threads = 1) const {
+        return dataset_checksum(data(), size(), num_threads) == checksum();
+    }
+
+private:
+    DatasetHeader& header() { return *reinterpret_cast<DatasetHeader*>(base_); }
+    const DatasetHeader& header() const { return *reinterpret_cast<const DatasetHeader*>(base_); }
+
+    void open_file(const std::string& path, int flags) {
+        fd_ = ::open(path.c_str(), flags, 0644);
+        if (fd_ < 0) throw std::runtime_error("dataset: cannot open " + path);
+    }
+
+    void close_file() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    void map(size_t bytes, bool writable) {
+        int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+        void* mapped = mmap(nullptr, bytes, prot, MAP_SHARED, fd_, 0);
+        if (mapped == MAP_FAILED) {
+            close_file();
+            throw std::runtime_error("dataset: cannot map file");
+        }
+        base_ = static_cast<char*>(mapped);
+        bytes_ = bytes;
+        madvise(base_, bytes_, MADV_SEQUENTIAL);
+    }
+
+    void unmap() {
+        if (base_) munmap(base_, bytes_);
+        base_ = nullptr;
+        bytes_ = 0;
+        close_file();
+    }
+
+    int fd_ = -1;
+    char* base_ = nullptr;
+    size_t bytes_ = 0;
+};
+
+// Writes count elements to a new dataset file at `path` and seals it
+template <typename T>
+void write_dataset(const std::string& path, const T* data, size_t count, uint64_t seed,
+                   unsigned num_threads = 1) {
+    MappedDataset<T> dataset(path, count, seed);
+    std::copy(data, data + count, dataset.data());
+    dataset.seal(dataset_checksum(data, count, num_threads));
+}
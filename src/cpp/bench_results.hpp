@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cmath>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Optional result columns collected by the C++ benchmarks next to the fixed serial/parallel
+// timings, written to the JSON log in insertion order
+using ResultList = std::vector<std::pair<std::string, double>>;
+
+// Writes each result as an extra JSON member, each preceded by ",\n"
+inline void write_result_fields(std::ostream& out, const ResultList& results) {
+    for (const auto& [key, value] : results) {
+        out << ",\n  \"" << key << "\": ";
+        // Counts and sizes are written exactly rather than in scientific notation
+        if (value == std::floor(value) && std::abs(value) < 1e15) {
+            out << static_cast<long long>(value);
+        } else {
+            out << value;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <random>
+#include <vector>
+
+// Counter-based random number generation for benchmark inputs.
+//
+// Element i of a dataset is a pure function of (seed, i): the SplitMix64 output for
+// step i. Any thread or MPI rank can therefore generate any slice on its own, and the
+// data for a given seed is bit-identical no matter how the work is split.
+
+class CounterRng {
+public:
+    explicit CounterRng(uint64_t seed) : seed_(seed) {}
+
+    uint64_t seed() const { return seed_; }
+
+    // Raw 64-bit value for counter `index`
+    uint64_t bits(uint64_t index) const {
+        uint64_t z = seed_ + (index + 1) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Integer in [lo, hi] (multiply-shift range reduction, no rejection loop)
+    int64_t uniform_int(uint64_t index, int64_t lo, int64_t hi) const {
+        uint64_t range = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo) + 1;
+        if (range == 0) return static_cast<int64_t>(bits(index));
+        unsigned __int128 scaled = static_cast<unsigned __int128>(bits(index)) * range;
+        return lo + static_cast<int64_t>(static_cast<uint64_t>(scaled >> 64));
+    }
+
+    // Double in [0, 1) with 53 random bits
+    double uniform_real(uint64_t index) const {
+        return static_cast<double>(bits(index) >> 11) * 0x1.0p-53;
+    }
+
+private:
+    uint64_t seed_;
+};
+
+// Fresh non-deterministic seed, used when no --seed is given
+inline uint64_t random_seed() {
+    std::random_device rd;
+    return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+// Writes out[k] = value_at(first_index + k) for k in [0, count), split across threads.
+// `first_index` lets a caller (e.g. an MPI rank) generate just its slice of a larger dataset.
+template <typename T, typename Fn>
+void parallel_generate(T* out, size_t count, uint64_t first_index, unsigned int num_threads,
+                       Fn value_at) {
+    num_threads = std::max(1u, num_threads);
+    size_t chunk_size = (count + num_threads - 1) / num_threads;
+    if (num_threads == 1 || chunk_size == 0) {
+        for (size_t k = 0; k < count; k++) out[k] = value_at(first_index + k);
+        return;
+    }
+
+    std::vector<std::future<void>> futures;
+    for (size_t begin = 0; begin < count; begin += chunk_size) {
+        size_t end = std::min(begin + chunk_size, count);
+        futures.push_back(std::async(std::launch::async, [=]() {
+            for (size_t k = begin; k < end; k++) out[k] = value_at(first_index + k);
+        }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+}
+
+// Fills out with uniform integers in [lo, hi]; element k is dataset element first_index + k
+template <typename T>
+void fill_uniform_int(T* out, size_t count, uint64_t first_index, const CounterRng& rng,
+                      int64_t lo, int64_t hi, unsigned int num_threads) {
+    parallel_generate(out, count, first_index, num_threads, [&rng, lo, hi](uint64_t i) {
+        return static_cast<T>(rng.uniform_int(i, lo, hi));
+    });
+}
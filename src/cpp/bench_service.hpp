@@ -0,0 +1,414 @@
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_rng.hpp"
+
+// Long-running benchmark service on a Unix domain socket, and a load generator for it.
+//
+// The service keeps its worker threads, per-worker key buffers and whatever the handler
+// precomputes warm across requests, so none of that is paid per run. An I/O thread polls the
+// connections and queues each request header it reads. Whenever the previous batch has
+// finished, everything queued since becomes the next batch: the workers are woken once for
+// it, share its requests out, read any payload and answer on the request's connection. A
+// connection has at most one request in flight, since the I/O thread stops polling it until
+// the response is written.
+//
+// Messages are fixed-size headers in host byte order (both ends are on one machine). A sort
+// request is followed by `arg` int keys and answered with the keys sorted. A Fibonacci
+// request is answered with F(arg), so arg is at most kMaxServiceFibonacci (F(93) is the last
+// Fibonacci number that fits in 64 bits).
+
+enum class ServiceOp : uint32_t { Sort = 1, CountPrimes = 2, Fibonacci = 3, Shutdown = 4 };
+
+constexpr uint64_t kMaxServiceFibonacci = 93;
+
+struct ServiceRequest {
+    uint32_t op;
+    uint32_t reserved;
+    uint64_t arg; // key count, prime limit or Fibonacci index
+};
+
+struct ServiceResponse {
+    uint32_t status; // 0 ok, 1 unknown request, 2 argument out of range
+    uint32_t reserved;
+    uint64_t value; // key count, prime count or F(n) mod 2^64
+};
+
+inline bool send_all(int fd, const void* data, size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = ::send(fd, p, bytes, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+inline bool recv_all(int fd, void* data, size_t bytes) {
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t n = ::recv(fd, p, bytes, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+inline sockaddr_un service_address(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("service: socket path too long: " + path);
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    return address;
+}
+
+inline int connect_service(const std::string& path) {
+    sockaddr_un address = service_address(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("service: cannot connect to " + path);
+    }
+    return fd;
+}
+
+// Sends one request and waits for the answer. For a sort, `keys` is sent and replaced by
+// the sorted keys.
+inline ServiceResponse call_service(int fd, ServiceOp op, uint64_t arg,
+                                    std::vector<int>* keys = nullptr) {
+    ServiceRequest request{static_cast<uint32_t>(op), 0, arg};
+    ServiceResponse response{};
+    bool ok = send_all(fd, &request, sizeof(request));
+    if (ok && op == ServiceOp::Sort) ok = send_all(fd, keys->data(), arg * sizeof(int));
+    if (ok) ok = recv_all(fd, &response, sizeof(response));
+    if (ok && op == ServiceOp::Sort && response.status == 0) {
+        ok = recv_all(fd, keys->data(), arg * sizeof(int));
+    }
+    if (!ok) throw std::runtime_error("service: connection lost");
+    return response;
+}
+
+// Answers one request on a worker thread. For a sort, `keys` holds the keys and is sorted in
+// place; `scratch` is the worker's warm buffer for sorts that need a second one.
+using ServiceHandler = std::function<uint64_t(const ServiceRequest&, std::vector<int>& keys,
+                                              std::vector<int>& scratch)>;
+
+class BenchService {
+public:
+    // Sort requests may carry up to `max_keys` keys; each worker preallocates a key buffer and a
+    // scratch buffer that size
+    BenchService(const std::string& path, unsigned num_threads, size_t max_keys,
+                 ServiceHandler handler)
+        : path_(path), max_keys_(max_keys), handler_(std::move(handler)) {
+        sockaddr_un address = service_address(path);
+        ::unlink(path.c_str());
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd_ < 0 ||
+            ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listen_fd_, 128) != 0 || ::pipe(wake_pipe_) != 0) {
+            throw std::runtime_error("service: cannot listen on " + path);
+        }
+        ::fcntl(wake_pipe_[0], F_SETFL, O_NONBLOCK);
+        ::fcntl(wake_pipe_[1], F_SETFL, O_NONBLOCK);
+
+        num_threads = std::max(1u, num_threads);
+        buffers_.resize(num_threads);
+        scratch_.resize(num_threads);
+        for (unsigned w = 0; w < num_threads; w++) {
+            buffers_[w].reserve(max_keys);
+            scratch_[w].reserve(max_keys);
+            workers_.emplace_back([this, w]() { worker_loop(w); });
+        }
+    }
+
+    ~BenchService() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            workers_stop_ = true;
+        }
+        work_ready_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+        for (auto& connection : connections_) {
+            ::close(connection->fd);
+        }
+        ::close(listen_fd_);
+        ::close(wake_pipe_[0]);
+        ::close(wake_pipe_[1]);
+        ::unlink(path_.c_str());
+    }
+
+    // Serves until a Shutdown request arrives or stop() is called
+    void run() {
+        std::shared_ptr<Batch> running;
+        std::vector<Job> queued;
+        std::vector<pollfd> fds;
+        std::vector<Connection*> polled;
+        while (!stopping_.load()) {
+            fds.assign({{wake_pipe_[0], POLLIN, 0}, {listen_fd_, POLLIN, 0}});
+            polled.clear();
+            for (auto& connection : connections_) {
+                if (connection->busy.load() || connection->dead.load()) continue;
+                fds.push_back({connection->fd, POLLIN, 0});
+                polled.push_back(connection.get());
+            }
+            if (::poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) break;
+
+            char drain[64];
+            while (::read(wake_pipe_[0], drain, sizeof(drain)) > 0) {
+            }
+            if (fds[1].revents & POLLIN) {
+                int fd = ::accept(listen_fd_, nullptr, nullptr);
+                if (fd >= 0) connections_.push_back(std::make_unique<Connection>(fd));
+            }
+            for (size_t i = 0; i < polled.size(); i++) {
+                if (!fds[i + 2].revents) continue;
+                Connection* connection = polled[i];
+                ServiceRequest request;
+                if (!recv_all(connection->fd, &request, sizeof(request))) {
+                    connection->dead = true;
+                } else if (request.op == static_cast<uint32_t>(ServiceOp::Shutdown)) {
+                    stopping_ = true;
+                } else {
+                    connection->busy = true;
+                    queued.push_back({connection, request});
+                }
+            }
+
+            // Hand everything queued to the workers once they are done with the last batch
+            if (running && running->remaining.load() == 0) running.reset();
+            if (!running && !queued.empty()) {
+                running = std::make_shared<Batch>();
+                running->jobs.swap(queued);
+                running->remaining = running->jobs.size();
+                requests_ += running->jobs.size();
+                batches_++;
+                {
+                    std::lock_guard<std::mutex> guard(lock_);
+                    batch_ = running;
+                    generation_++;
+                }
+                work_ready_.notify_all();
+            }
+
+            connections_.erase(std::remove_if(connections_.begin(), connections_.end(),
+                [](const std::unique_ptr<Connection>& c) {
+                    if (!c->dead.load() || c->busy.load()) return false;
+                    ::close(c->fd);
+                    return true;
+                }), connections_.end());
+        }
+        while (running && running->remaining.load() > 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Safe to call from another thread or a signal handler
+    void stop() {
+        stopping_ = true;
+        wake();
+    }
+
+    uint64_t requests() const { return requests_; }
+    uint64_t batches() const { return batches_; }
+
+private:
+    struct Connection {
+        explicit Connection(int fd) : fd(fd) {}
+        int fd;
+        std::atomic<bool> busy{false};
+        std::atomic<bool> dead{false};
+    };
+
+    struct Job {
+        Connection* connection;
+        ServiceRequest request;
+    };
+
+    // Each batch is its own object so a worker finishing one can never take jobs of the next
+    struct Batch {
+        std::vector<Job> jobs;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> remaining{0};
+    };
+
+    void wake() {
+        char byte = 1;
+        [[maybe_unused]] ssize_t n = ::write(wake_pipe_[1], &byte, 1);
+    }
+
+    void worker_loop(unsigned index) {
+        uint64_t seen = 0;
+        while (true) {
+            std::shared_ptr<Batch> batch;
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                work_ready_.wait(lock, [&]() { return workers_stop_ || generation_ != seen; });
+                if (workers_stop_) return;
+                seen = generation_;
+                batch = batch_;
+            }
+            for (size_t j = batch->next++; j < batch->jobs.size(); j = batch->next++) {
+                serve(batch->jobs[j], buffers_[index], scratch_[index]);
+                batch->remaining--;
+                wake();
+            }
+        }
+    }
+
+    void serve(const Job& job, std::vector<int>& keys, std::vector<int>& scratch) {
+        Connection& connection = *job.connection;
+        const ServiceRequest& request = job.request;
+        ServiceResponse response{0, 0, 0};
+        bool ok = true;
+        switch (static_cast<ServiceOp>(request.op)) {
+            case ServiceOp::Sort:
+                // Larger requests cannot be answered from the warm buffer; drop the client
+                ok = request.arg <= max_keys_;
+                if (ok) {
+                    keys.resize(request.arg);
+                    ok = recv_all(connection.fd, keys.data(), keys.size() * sizeof(int));
+                }
+                if (ok) response.value = handler_(request, keys, scratch);
+                break;
+            case ServiceOp::Fibonacci:
+                if (request.arg > kMaxServiceFibonacci) {
+                    response.status = 2;
+                    break;
+                }
+                response.value = handler_(request, keys, scratch);
+                break;
+            case ServiceOp::CountPrimes:
+                response.value = handler_(request, keys, scratch);
+                break;
+            default:
+                response.status = 1;
+        }
+        if (ok) ok = send_all(connection.fd, &response, sizeof(response));
+        if (ok && request.op == static_cast<uint32_t>(ServiceOp::Sort)) {
+            ok = send_all(connection.fd, keys.data(), keys.size() * sizeof(int));
+        }
+        if (!ok) connection.dead = true;
+        connection.busy = false;
+    }
+
+    std::string path_;
+    size_t max_keys_;
+    ServiceHandler handler_;
+    int listen_fd_ = -1;
+    int wake_pipe_[2] = {-1, -1};
+    std::atomic<bool> stopping_{false};
+    std::vector<std::unique_ptr<Connection>> connections_;
+    uint64_t requests_ = 0;
+    uint64_t batches_ = 0;
+
+    std::vector<std::vector<int>> buffers_;
+    std::vector<std::vector<int>> scratch_;
+    std::vector<std::thread> workers_;
+    std::mutex lock_;
+    std::condition_variable work_ready_;
+    std::shared_ptr<Batch> batch_;
+    uint64_t generation_ = 0;
+    bool workers_stop_ = false;
+};
+
+struct ServiceLoadStats {
+    uint64_t requests = 0;
+    double seconds = 0;
+    double p50_latency = 0; // seconds
+    double p99_latency = 0;
+    double max_latency = 0;
+    bool ok = true;
+};
+
+// Closed-loop load: `clients` connections each send `requests_per_client` requests, one at a
+// time, cycling through a sort of `sort_keys` random keys, pi(prime_limit) and F(fib_n) (fib_n
+// at most kMaxServiceFibonacci).
+// Sorted replies are checked, and so is every prime count against the first one.
+inline ServiceLoadStats run_service_load(const std::string& path, unsigned clients,
+                                         size_t requests_per_client, size_t sort_keys,
+                                         uint64_t prime_limit, uint64_t fib_n,
+                                         const CounterRng& rng) {
+    using clock = std::chrono::high_resolution_clock;
+    std::atomic<bool> ok{true};
+    std::atomic<uint64_t> prime_count{0};
+    std::vector<std::future<std::vector<double>>> futures;
+    auto start = clock::now();
+    for (unsigned c = 0; c < std::max(1u, clients); c++) {
+        futures.push_back(std::async(std::launch::async, [&, c]() {
+            std::vector<double> latencies;
+            latencies.reserve(requests_per_client);
+            int fd = connect_service(path);
+            std::vector<int> keys(sort_keys);
+            for (size_t i = 0; i < requests_per_client; i++) {
+                ServiceOp op = i % 3 == 0 ? ServiceOp::Sort
+                             : i % 3 == 1 ? ServiceOp::CountPrimes : ServiceOp::Fibonacci;
+                if (op == ServiceOp::Sort) {
+                    uint64_t first = (uint64_t(c) * requests_per_client + i) * sort_keys;
+                    fill_uniform_int(keys.data(), sort_keys, first, rng, 1, 1000000, 1);
+                }
+                uint64_t arg = op == ServiceOp::Sort ? sort_keys
+                             : op == ServiceOp::CountPrimes ? prime_limit : fib_n;
+                auto request_start = clock::now();
+                ServiceResponse response = call_service(fd, op, arg, &keys);
+                latencies.push_back(std::chrono::duration<double>(clock::now() - request_start).count());
+
+                bool good = response.status == 0;
+                if (op == ServiceOp::Sort) good = good && std::is_sorted(keys.begin(), keys.end());
+                if (op == ServiceOp::CountPrimes) {
+                    uint64_t expected = 0;
+                    prime_count.compare_exchange_strong(expected, response.value);
+                    good = good && response.value == prime_count.load();
+                }
+                if (!good) ok = false;
+            }
+            ::close(fd);
+            return latencies;
+        }));
+    }
+
+    std::vector<double> latencies;
+    for (auto& future : futures) {
+        auto part = future.get();
+        latencies.insert(latencies.end(), part.begin(), part.end());
+    }
+    ServiceLoadStats stats;
+    stats.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    stats.requests = latencies.size();
+    stats.ok = ok;
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        stats.p50_latency = latencies[latencies.size() / 2];
+        stats.p99_latency = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+        stats.max_latency = latencies.back();
+    }
+    return stats;
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <initializer_list>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "segmented_sieve.hpp"
+
+// Checkpoint files for long-running kernels, so an interrupted run can resume.
+//
+// A kernel describes its progress as a vector of 64-bit words: positions, partial counts and
+// the bit patterns of doubles. It offers that state to save() at its natural step boundaries.
+// save() only writes once the interval since the last write has passed, so the overhead is
+// one small file write per interval however fine the steps are. The file is written under a
+// temporary name, flushed and renamed over the old one, so a crash leaves either the old or the
+// new checkpoint. Each file carries a fingerprint of the kernel's parameters, and only a run
+// with the same parameters restores it.
+
+inline uint64_t checkpoint_fingerprint(std::initializer_list<uint64_t> parameters) {
+    uint64_t h = 0x6A09E667F3BCC909ULL;
+    for (uint64_t p : parameters) {
+        uint64_t z = h + p + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        h = z ^ (z >> 31);
+    }
+    return h;
+}
+
+inline uint64_t double_to_word(double value) {
+    uint64_t word;
+    std::memcpy(&word, &value, sizeof(word));
+    return word;
+}
+
+inline double word_to_double(uint64_t word) {
+    double value;
+    std::memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+class Checkpoint {
+public:
+    // Disabled: save() and finish() do nothing
+    Checkpoint() = default;
+
+    // Checkpoints to `path`; with `resume`, first restores what an earlier run with the same
+    // fingerprint saved there
+    Checkpoint(std::string path, uint64_t fingerprint, double interval_seconds, bool resume)
+        : path_(std::move(path)), fingerprint_(fingerprint), interval_(interval_seconds),
+          last_save_(std::chrono::steady_clock::now()) {
+        if (resume) load();
+    }
+
+    bool enabled() const { return !path_.empty(); }
+
+    // The state restored from an earlier run, or empty
+    const std::vector<uint64_t>& restored() const { return restored_; }
+
+    bool due() const {
+        return enabled() && std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                          last_save_).count() >= interval_;
+    }
+
+    // Writes `state` if the interval has passed (or `force`); returns whether it did. The first
+    // failed write is reported on stderr, since the run itself goes on without checkpoints.
+    bool save(const std::vector<uint64_t>& state, bool force = false) {
+        if (!enabled() || (!force && !due())) return false;
+        auto start = std::chrono::steady_clock::now();
+        std::string temp = path_ + ".tmp";
+        bool written = false;
+        if (std::FILE* file = std::fopen(temp.c_str(), "wb")) {
+            Header header{kMagic, fingerprint_, state.size(), 0};
+            written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                      std::fwrite(state.data(), sizeof(uint64_t), state.size(), file) ==
+                          state.size() &&
+                      std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+            written = std::fclose(file) == 0 && written;
+            if (written) written = std::rename(temp.c_str(), path_.c_str()) == 0;
+        }
+        if (!written && failures_++ == 0) {
+            std::cerr << "Cannot write checkpoint " << path_ << ": " << std::strerror(errno)
+                      << std::endl;
+        }
+        last_save_ = std::chrono::steady_clock::now();
+        save_seconds_ += std::chrono::duration<double>(last_save_ - start).count();
+        saves_ += written;
+        return written;
+    }
+
+    // Removes the checkpoint once the kernel has finished
+    void finish() {
+        if (enabled()) std::remove(path_.c_str());
+    }
+
+    size_t saves() const { return saves_; }
+    size_t failures() const { return failures_; }
+    double save_seconds() const { return save_seconds_; }
+
+private:
+    struct Header {
+        uint64_t magic;
+        uint64_t fingerprint;
+        uint64_t words;
+        uint64_t reserved;
+    };
+    static constexpr uint64_t kMagic = 0x31544E494F504B43; // "CKPOINT1"
+
+    void load() {
+        std::FILE* file = std::fopen(path_.c_str(), "rb");
+        if (!file) return;
+        Header header;
+        if (std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == kMagic &&
+            header.fingerprint == fingerprint_ && header.words < (uint64_t(1) << 32)) {
+            restored_.resize(header.words);
+            if (std::fread(restored_.data(), sizeof(uint64_t), restored_.size(), file) !=
+                restored_.size()) {
+                restored_.clear();
+            }
+        }
+        std::fclose(file);
+    }
+
+    std::string path_;
+    uint64_t fingerprint_ = 0;
+    double interval_ = 0;
+    std::chrono::steady_clock::time_point last_save_;
+    std::vector<uint64_t> restored_;
+    size_t saves_ = 0;
+    size_t failures_ = 0;
+    double save_seconds_ = 0;
+};
+
+// Where and how often the kernels checkpoint; an empty dir disables checkpointing
+struct CheckpointConfig {
+    std::string dir;
+    double interval_seconds = 60;
+    bool resume = false;
+
+    Checkpoint open(const std::string& name, uint64_t fingerprint) const {
+        if (dir.empty()) return Checkpoint();
+        return Checkpoint(dir + "/" + name + ".ckpt", fingerprint, interval_seconds, resume);
+    }
+};
+
+// Number of primes in [lo, hi), like count_primes(), resumable through `checkpoint`. The range
+// is cut into slices of 16 sieve blocks, which threads take in turn. The checkpoint holds the
+// count of every finished slice, so a resumed run only sieves the slices that were missing.
+inline uint64_t count_primes_checkpointed(uint64_t lo, uint64_t hi,
+                                          const std::vector<uint32_t>& primes,
+                                          unsigned num_threads, Checkpoint& checkpoint,
+                                          size_t block_bytes = kSieveBlockBytes) {
+    constexpr uint64_t kPending = ~uint64_t(0);
+    if (hi <= lo) return 0;
+    uint64_t slice = std::max<size_t>(block_bytes, 8) / 8 * 64 * 2 * 16;
+    size_t slices = (hi - lo + slice - 1) / slice;
+    std::vector<uint64_t> counts = checkpoint.restored();
+    if (counts.size() != slices) counts.assign(slices, kPending);
+
+    std::vector<size_t> todo;
+    for (size_t i = 0; i < slices; i++) {
+        if (counts[i] == kPending) todo.push_back(i);
+    }
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    auto worker = [&]() {
+        for (size_t t = next++; t < todo.size(); t = next++) {
+            uint64_t begin = lo + todo[t] * slice;
+            uint64_t count = count_primes(begin, std::min(hi, begin + slice), primes,
+                                          block_bytes);
+            std::lock_guard<std::mutex> lock(mutex);
+            counts[todo[t]] = count;
+            checkpoint.save(counts);
+        }
+    };
+    num_threads = std::max(1u, std::min<unsigned>(num_threads, std::max<size_t>(1, todo.size())));
+    std::vector<std::future<void>> futures;
+    for (unsigned t = 1; t < num_threads; t++) {
+        futures.push_back(std::async(std::launch::async, worker));
+    }
+    worker();
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    uint64_t total = 0;
+    for (uint64_t count : counts) {
+        total += count;
+    }
+    checkpoint.finish();
+    return total;
+}
@@ -7,12 +7,45 @@
 #include <future>
 #include <fstream>
 #include <filesystem>
+#include <memory_resource>
+#include <numeric>
+#include <limits>
+#include <functional>
+#include <csignal>
+#include <optional>
+#include "alloc_tracker.hpp"
+#include "bench_arena.hpp"
+#include "bench_args.hpp"
+#include "bench_dataset.hpp"
+#include "bench_results.hpp"
+#include "bench_rng.hpp"
+#include "bench_service.hpp"
+#include "checkpoint.hpp"
+#include "external_sort.hpp"
+#include "huge_pages.hpp"
+#include "incremental_cache.hpp"
+#include "primality.hpp"
+#include "prime_count.hpp"
+#include "prime_stream.hpp"
+#include "sort_engine.hpp"
+#include "sort_pipeline.hpp"
+#include "static_kernels.hpp"
+#include "std_parallel.hpp"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // Global variable for process count
 unsigned int g_num_threads = std::thread::hardware_concurrency();
 
+// Checkpointing of the long-running kernels (--checkpoint-dir, --resume); off by default
+CheckpointConfig g_checkpoints;
+
 void set_thread_count(unsigned int count) {
     g_num_threads = count > 0 ? std::min(count, std::thread::hardware_concurrency()) : std::thread::hardware_concurrency();
+#ifdef _OPENMP
+    omp_set_num_threads(g_num_threads);
+#endif
 }
 
 // Fibonacci implementations
@@ -21,9 +54,9 @@ unsigned long long fibonacci_serial(int n) {
     return fibonacci_serial(n - 1) + fibonacci_serial(n - 2);
 }
 
-unsigned long long fibonacci_dynamic(int n) {
+unsigned long long fibonacci_dynamic(int n, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
     if (n <= 1) return n;
-    std::vector<unsigned long long> fib(n + 1);
+    std::pmr::vector<unsigned long long> fib(n + 1, resource);
     fib[1] = 1;
     for (int i = 2; i <= n; i++) {
         fib[i] = fib[i-1] + fib[i-2];
@@ -31,42 +64,65 @@ unsigned long long fibonacci_dynamic(int n) {
     return fib[n];
 }
 
-std::vector<unsigned long long> fibonacci_chunk(int start, int end) {
-    std::vector<unsigned long long> fib(end + 1);
-    if (start <= 1 && end >= 1) fib[1] = 1;
-    for (int i = std::max(2, start); i <= end; i++) {
-        fib[i] = fib[i-1] + fib[i-2];
+// F(k) and F(k+1) by fast doubling in O(log k), wrapping mod 2^64 like the iterative loop
+std::pair<unsigned long long, unsigned long long> fibonacci_pair(int k) {
+    if (k == 0) return {0, 1};
+    auto [a, b] = fibonacci_pair(k / 2);
+    unsigned long long even = a * (2 * b - a);
+    unsigned long long odd = a * a + b * b;
+    if (k % 2 == 0) return {even, odd};
+    return {odd, even + odd};
+}
+
+// Writes F(start) .. F(end - 1) to out[start] .. out[end - 1]
+void fibonacci_chunk(int start, int end, unsigned long long* out) {
+    if (start >= end) return;
+    auto [a, b] = fibonacci_pair(start);
+    out[start] = a;
+    if (start + 1 < end) out[start + 1] = b;
+    for (int i = start + 2; i < end; i++) {
+        out[i] = out[i-1] + out[i-2];
     }
-    return std::vector<unsigned long long>(fib.begin() + start, fib.begin() + end + 1);
 }
 
-std::vector<unsigned long long> fibonacci_parallel(int n) {
+// F(0) .. F(n - 1); each worker seeds its chunk by fast doubling and fills its own
+// slice of the preallocated result, so there are no per-chunk vectors or copies
+std::pmr::vector<unsigned long long> fibonacci_parallel(int n, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
     int chunk_size = std::max(1, static_cast<int>(n / g_num_threads));
-    std::vector<std::future<std::vector<unsigned long long>>> futures;
+    std::pmr::vector<unsigned long long> result(std::max(n, 0), resource);
+    std::pmr::vector<std::future<void>> futures(resource);
+    futures.reserve(n / chunk_size + 1);
     
     for (int i = 0; i < n; i += chunk_size) {
         int end = std::min(i + chunk_size, n);
-        futures.push_back(std::async(std::launch::async, fibonacci_chunk, i, end));
+        futures.push_back(std::async(std::launch::async, fibonacci_chunk, i, end, result.data()));
     }
     
-    std::vector<unsigned long long> result;
     for (auto& future : futures) {
-        auto chunk = future.get();
-        result.insert(result.end(), chunk.begin(), chunk.end());
+        future.get();
     }
     return result;
 }
 
-bool is_prime(int n) {
-    if (n < 2) return false;
-    for (int i = 2; i <= sqrt(n); i++) {
-        if (n % i == 0) return false;
+#ifdef _OPENMP
+// OpenMP version of fibonacci_parallel: the same chunks, handed out by a taskloop
+std::pmr::vector<unsigned long long> fibonacci_openmp(int n, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    int chunk_size = std::max(1, static_cast<int>(n / g_num_threads));
+    std::pmr::vector<unsigned long long> result(std::max(n, 0), resource);
+    unsigned long long* out = result.data();
+    
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskloop grainsize(1)
+    for (int i = 0; i < n; i += chunk_size) {
+        fibonacci_chunk(i, std::min(i + chunk_size, n), out);
     }
-    return true;
+    return result;
 }
+#endif
 
-std::vector<int> find_primes_serial(int limit) {
-    std::vector<int> primes;
+std::pmr::vector<int> find_primes_serial(int limit, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    std::pmr::vector<int> primes(resource);
     for (int n = 2; n <= limit; n++) {
         if (is_prime(n)) {
             primes.push_back(n);
@@ -75,97 +131,979 @@ std::vector<int> find_primes_serial(int limit) {
     return primes;
 }
 
-std::vector<int> find_primes_parallel(int limit) {
-    unsigned int num_threads = std::thread::hardware_concurrency();
-    std::vector<std::future<std::vector<int>>> futures;
-    std::vector<int> result;
+// Two passes over per-thread ranges: the first tests each number and records the result in a
+// shared bitmap (ranges are aligned to 64 numbers, so no word is shared) while counting, an
+// exclusive scan of the counts gives each thread its output offset, and the second pass
+// expands the bitmap straight into the exactly sized result. No merge or sort is needed
+// because ranges are in ascending order.
+std::pmr::vector<int> find_primes_parallel(int limit, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    if (limit < 2) return std::pmr::vector<int>(resource);
+    unsigned int num_threads = g_num_threads;
+    int words = limit / 64 + 1;
+    int words_per_thread = (words + num_threads - 1) / num_threads;
     
-    int chunk_size = limit / num_threads;
+    std::pmr::vector<uint64_t> bitmap(words, 0, resource);
+    std::pmr::vector<int> counts(num_threads, 0, resource);
+    std::pmr::vector<std::future<void>> futures(resource);
+    futures.reserve(num_threads);
     
-    for (unsigned int i = 0; i < num_threads; i++) {
-        int start = i * chunk_size + 2;
-        int end = (i == num_threads - 1) ? limit : (i + 1) * chunk_size + 1;
-        
-        futures.push_back(std::async(std::launch::async, [start, end]() {
-            std::vector<int> local_primes;
-            for (int n = start; n <= end; n++) {
+    for (unsigned int t = 0; t < num_threads; t++) {
+        int first_word = t * words_per_thread;
+        int last_word = std::min(words, first_word + words_per_thread);
+        futures.push_back(std::async(std::launch::async, [&, t, first_word, last_word]() {
+            int count = 0;
+            int end = std::min(limit, last_word * 64 - 1);
+            for (int n = std::max(2, first_word * 64); n <= end; n++) {
                 if (is_prime(n)) {
-                    local_primes.push_back(n);
+                    bitmap[n / 64] |= uint64_t(1) << (n % 64);
+                    count++;
                 }
             }
-            return local_primes;
+            counts[t] = count;
         }));
     }
-    
     for (auto& future : futures) {
-        auto partial_result = future.get();
-        result.insert(result.end(), partial_result.begin(), partial_result.end());
+        future.get();
     }
     
-    std::sort(result.begin(), result.end());
+    std::pmr::vector<int> offsets(num_threads, resource);
+    std::exclusive_scan(counts.begin(), counts.end(), offsets.begin(), 0);
+    std::pmr::vector<int> result(offsets.back() + counts.back(), resource);
+    
+    futures.clear();
+    for (unsigned int t = 0; t < num_threads; t++) {
+        int first_word = t * words_per_thread;
+        int last_word = std::min(words, first_word + words_per_thread);
+        futures.push_back(std::async(std::launch::async, [&, t, first_word, last_word]() {
+            int* out = result.data() + offsets[t];
+            for (int w = first_word; w < last_word; w++) {
+                for (uint64_t bits = bitmap[w]; bits != 0; bits &= bits - 1) {
+                    *out++ = w * 64 + __builtin_ctzll(bits);
+                }
+            }
+        }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
     return result;
 }
 
-void quicksort_serial(std::vector<int>& arr, int low, int high) {
-    if (low < high) {
-        int pivot = arr[high];
-        int i = low - 1;
-        
-        for (int j = low; j < high; j++) {
-            if (arr[j] <= pivot) {
-                i++;
-                std::swap(arr[i], arr[j]);
+#ifdef _OPENMP
+// OpenMP version of find_primes_parallel with the same two passes, but over fixed blocks of
+// words scheduled by the runtime schedule (--omp-schedule) instead of one range per thread:
+// testing gets slower as n grows, which dynamic and guided schedules even out
+std::pmr::vector<int> find_primes_openmp(int limit, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    if (limit < 2) return std::pmr::vector<int>(resource);
+    constexpr int block_words = 16; // 1024 numbers per block
+    int words = limit / 64 + 1;
+    int blocks = (words + block_words - 1) / block_words;
+    
+    std::pmr::vector<uint64_t> bitmap(words, 0, resource);
+    std::pmr::vector<int> counts(blocks, 0, resource);
+    
+    #pragma omp parallel for schedule(runtime)
+    for (int b = 0; b < blocks; b++) {
+        int count = 0;
+        int end = std::min(limit, std::min(words, (b + 1) * block_words) * 64 - 1);
+        for (int n = std::max(2, b * block_words * 64); n <= end; n++) {
+            if (is_prime(n)) {
+                bitmap[n / 64] |= uint64_t(1) << (n % 64);
+                count++;
+            }
+        }
+        counts[b] = count;
+    }
+    
+    std::pmr::vector<int> offsets(blocks, resource);
+    std::exclusive_scan(counts.begin(), counts.end(), offsets.begin(), 0);
+    std::pmr::vector<int> result(offsets.back() + counts.back(), resource);
+    
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < blocks; b++) {
+        int* out = result.data() + offsets[b];
+        for (int w = b * block_words; w < std::min(words, (b + 1) * block_words); w++) {
+            for (uint64_t bits = bitmap[w]; bits != 0; bits &= bits - 1) {
+                *out++ = w * 64 + __builtin_ctzll(bits);
             }
         }
-        std::swap(arr[i + 1], arr[high]);
-        
-        int pi = i + 1;
-        quicksort_serial(arr, low, pi - 1);
-        quicksort_serial(arr, pi + 1, high);
     }
+    return result;
 }
+#endif
 
-void quicksort_parallel(std::vector<int>& arr, int low, int high, int depth = 0) {
-    if (low < high) {
-        if (depth >= 3) { // Limit parallel recursion depth
-            quicksort_serial(arr, low, high);
-            return;
-        }
+// 16-byte key/value record for the typed sort benchmark
+struct Record {
+    uint64_t key;
+    uint64_t value;
+};
+
+// Sorts `size` generated elements of type T with the generic parallel quicksort, the
+// sort_keys() dispatch and the parallel merge sort, appending "sort_<name>_quicksort",
+// "sort_<name>_engine" and "sort_<name>_mergesort"
+template <typename T, typename Compare, typename Gen>
+void run_typed_sort(const std::string& name, size_t size, Gen value_at, Compare comp,
+                    ResultList& results) {
+    std::vector<T> data(size);
+    parallel_generate(data.data(), size, 0, g_num_threads, value_at);
+    auto data_copy = data;
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    quicksort_parallel(data.begin(), data.end(), comp);
+    auto end = std::chrono::high_resolution_clock::now();
+    double quicksort_time = std::chrono::duration<double>(end - start).count();
+    bool quicksort_ok = std::is_sorted(data.begin(), data.end(), comp);
+    
+    start = std::chrono::high_resolution_clock::now();
+    sort_keys(data_copy.begin(), data_copy.end(), comp);
+    end = std::chrono::high_resolution_clock::now();
+    double engine_time = std::chrono::duration<double>(end - start).count();
+    bool engine_ok = std::is_sorted(data_copy.begin(), data_copy.end(), comp);
+    
+    parallel_generate(data_copy.data(), size, 0, g_num_threads, value_at);
+    start = std::chrono::high_resolution_clock::now();
+    merge_sort_parallel(data_copy.begin(), data_copy.end(), comp);
+    end = std::chrono::high_resolution_clock::now();
+    double merge_time = std::chrono::duration<double>(end - start).count();
+    bool merge_ok = std::is_sorted(data_copy.begin(), data_copy.end(), comp);
+    
+    std::cout << name << ": quicksort " << quicksort_time << " s"
+              << (quicksort_ok ? "" : " (NOT SORTED)") << ", engine " << engine_time << " s"
+              << (engine_ok ? "" : " (NOT SORTED)") << ", merge sort " << merge_time << " s"
+              << (merge_ok ? "" : " (NOT SORTED)") << std::endl;
+    results.emplace_back("sort_" + name + "_quicksort", quicksort_time);
+    results.emplace_back("sort_" + name + "_engine", engine_time);
+    results.emplace_back("sort_" + name + "_mergesort", merge_time);
+}
+
+// Times quicksort_serial and quicksort_parallel on inputs that defeat a naive quicksort
+// (sorted, reversed, equal, few distinct keys, organ pipe, sawtooth, sorted with 1% noise),
+// appending "sort_adversarial_<pattern>_serial" and "_parallel"
+void run_adversarial_sorts(size_t size, const CounterRng& rng, ResultList& results) {
+    const std::pair<const char*, std::function<int(size_t)>> patterns[] = {
+        {"sorted", [](size_t i) { return static_cast<int>(i); }},
+        {"reversed", [size](size_t i) { return static_cast<int>(size - i); }},
+        {"equal", [](size_t) { return 42; }},
+        {"few_unique", [&rng](size_t i) { return static_cast<int>(rng.bits(i) % 16); }},
+        {"organ_pipe", [size](size_t i) { return static_cast<int>(std::min(i, size - i)); }},
+        {"sawtooth", [](size_t i) { return static_cast<int>(i % 1000); }},
+        {"noisy_sorted", [&rng](size_t i) {
+            return static_cast<int>(rng.bits(i) % 100 == 0 ? rng.bits(~i) % 1000000 : i);
+        }},
+    };
+    
+    std::vector<int> data(size);
+    for (const auto& [name, value_at] : patterns) {
+        parallel_generate(data.data(), size, 0, g_num_threads, value_at);
+        auto start = std::chrono::high_resolution_clock::now();
+        quicksort_serial(data.begin(), data.end());
+        auto end = std::chrono::high_resolution_clock::now();
+        double serial_time = std::chrono::duration<double>(end - start).count();
+        bool serial_ok = std::is_sorted(data.begin(), data.end());
         
-        int pivot = arr[high];
-        int i = low - 1;
+        parallel_generate(data.data(), size, 0, g_num_threads, value_at);
+        start = std::chrono::high_resolution_clock::now();
+        quicksort_parallel(data.begin(), data.end());
+        end = std::chrono::high_resolution_clock::now();
+        double parallel_time = std::chrono::duration<double>(end - start).count();
+        bool parallel_ok = std::is_sorted(data.begin(), data.end());
         
-        for (int j = low; j < high; j++) {
-            if (arr[j] <= pivot) {
-                i++;
-                std::swap(arr[i], arr[j]);
-            }
+        std::cout << name << ": serial " << serial_time << " s"
+                  << (serial_ok ? "" : " (NOT SORTED)") << ", parallel " << parallel_time
+                  << " s" << (parallel_ok ? "" : " (NOT SORTED)") << std::endl;
+        results.emplace_back(std::string("sort_adversarial_") + name + "_serial", serial_time);
+        results.emplace_back(std::string("sort_adversarial_") + name + "_parallel", parallel_time);
+    }
+}
+
+// Runs the Fibonacci, prime and sort kernels through the standard parallel algorithms
+// (std_parallel.hpp), checks them against the hand-written kernels and appends
+// "fibonacci_std_par", "primes_std_par", "sort_std_par" and "std_par_enabled"
+void run_std_parallel(int fib_n, int prime_limit, int sort_size, uint64_t seed,
+                      ResultList& results) {
+    std::cout << "Backend: " << std_parallel_backend() << std::endl;
+    results.emplace_back("std_par_enabled", kStdParallel ? 1 : 0);
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    auto fib = std_par_fibonacci(fib_n);
+    auto end = std::chrono::high_resolution_clock::now();
+    double fib_time = std::chrono::duration<double>(end - start).count();
+    auto expected_fib = fibonacci_parallel(fib_n);
+    bool fib_ok = std::equal(fib.begin(), fib.end(), expected_fib.begin(), expected_fib.end());
+    std::cout << "Fibonacci (exclusive_scan): " << fib_time << " seconds"
+              << (fib_ok ? "" : " (MISMATCH)") << std::endl;
+    results.emplace_back("fibonacci_std_par", fib_time);
+    
+    start = std::chrono::high_resolution_clock::now();
+    size_t prime_count = std_par_count_primes(prime_limit);
+    end = std::chrono::high_resolution_clock::now();
+    double primes_time = std::chrono::duration<double>(end - start).count();
+    bool primes_ok = prime_count == find_primes_parallel(prime_limit).size();
+    std::cout << "Primes (transform_reduce): " << primes_time << " seconds, " << prime_count
+              << " primes" << (primes_ok ? "" : " (MISMATCH)") << std::endl;
+    results.emplace_back("primes_std_par", primes_time);
+    
+    // Same input as the main sort test
+    std::vector<int> data(sort_size);
+    fill_uniform_int(data.data(), sort_size, 0, CounterRng(seed), 1, 1000000, g_num_threads);
+    start = std::chrono::high_resolution_clock::now();
+    std_par_sort(data.begin(), data.end());
+    end = std::chrono::high_resolution_clock::now();
+    double sort_time = std::chrono::duration<double>(end - start).count();
+    bool sort_ok = std::is_sorted(data.begin(), data.end());
+    std::cout << "Sort (std::sort): " << sort_time << " seconds"
+              << (sort_ok ? "" : " (NOT SORTED)") << std::endl;
+    results.emplace_back("sort_std_par", sort_time);
+}
+
+#ifdef BENCH_COROUTINES
+// Complete binary tree of empty tasks, 2^(depth + 1) - 1 in all
+Task spawn_tree(int depth) {
+    if (depth == 0) co_return;
+    co_await spawn(spawn_tree(depth - 1));
+    co_await spawn(spawn_tree(depth - 1));
+    co_await join();
+}
+#endif
+
+void async_tree(int depth) {
+    if (depth == 0) return;
+    std::future<void> left = std::async(std::launch::async, async_tree, depth - 1);
+    async_tree(depth - 1);
+    left.wait();
+}
+
+// Measures fork/join cost per task on the coroutine runtime (task_runtime.hpp) and with
+// std::async, and times the coroutine ports of the parallel quicksort and merge sort on the
+// main sort input. Appends "task_fork_join_coroutine_ns", "task_fork_join_async_ns",
+// "sort_coroutine" and "sort_merge_coroutine".
+void run_coroutine_tasks(int sort_size, uint64_t seed, ResultList& results) {
+    // std::async starts a thread per task, so its tree is kept smaller
+    const int async_depth = 10;
+    auto start = std::chrono::high_resolution_clock::now();
+    async_tree(async_depth);
+    auto end = std::chrono::high_resolution_clock::now();
+    double async_ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                      ((2 << async_depth) - 1);
+    std::cout << "Fork/join, std::async: " << async_ns << " ns per task" << std::endl;
+    results.emplace_back("task_fork_join_async_ns", async_ns);
+    
+#ifdef BENCH_COROUTINES
+    TaskPool pool(g_num_threads);
+    const int tree_depth = 18;
+    start = std::chrono::high_resolution_clock::now();
+    pool.run(spawn_tree(tree_depth));
+    end = std::chrono::high_resolution_clock::now();
+    double coroutine_ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                          ((2 << tree_depth) - 1);
+    std::cout << "Fork/join, coroutines: " << coroutine_ns << " ns per task" << std::endl;
+    results.emplace_back("task_fork_join_coroutine_ns", coroutine_ns);
+    
+    std::vector<int> data(sort_size);
+    fill_uniform_int(data.data(), sort_size, 0, CounterRng(seed), 1, 1000000, g_num_threads);
+    start = std::chrono::high_resolution_clock::now();
+    quicksort_coroutine(pool, data.begin(), data.end());
+    end = std::chrono::high_resolution_clock::now();
+    double quicksort_time = std::chrono::duration<double>(end - start).count();
+    bool quicksort_ok = std::is_sorted(data.begin(), data.end());
+    
+    fill_uniform_int(data.data(), sort_size, 0, CounterRng(seed), 1, 1000000, g_num_threads);
+    start = std::chrono::high_resolution_clock::now();
+    merge_sort_coroutine(pool, data.begin(), data.end());
+    end = std::chrono::high_resolution_clock::now();
+    double merge_time = std::chrono::duration<double>(end - start).count();
+    bool merge_ok = std::is_sorted(data.begin(), data.end());
+    
+    std::cout << "Quicksort: " << quicksort_time << " seconds"
+              << (quicksort_ok ? "" : " (NOT SORTED)") << ", merge sort: " << merge_time
+              << " seconds" << (merge_ok ? "" : " (NOT SORTED)") << std::endl;
+    results.emplace_back("sort_coroutine", quicksort_time);
+    results.emplace_back("sort_merge_coroutine", merge_time);
+#else
+    (void)sort_size;
+    (void)seed;
+    std::cout << "Coroutine runtime not built in (compile with -std=c++20)" << std::endl;
+#endif
+}
+
+// Runs generate -> sort -> merge -> verify as a pipeline (sort_pipeline.hpp) with one sorter
+// per thread, appending "pipeline_time", "pipeline_throughput" (keys/s) and
+// "pipeline_<stage>_occupancy"
+void run_pipeline(size_t keys, size_t block_keys, size_t fan_in, uint64_t seed,
+                  ResultList& results) {
+    PipelineStats stats = run_sort_pipeline(keys, block_keys, fan_in, g_num_threads,
+                                            CounterRng(seed));
+    double throughput = stats.keys / stats.seconds;
+    std::cout << "Time: " << stats.seconds << " seconds, " << throughput << " keys/s"
+              << (stats.verified ? "" : " (VERIFICATION FAILED)") << std::endl;
+    std::cout << "Occupancy: generate " << stats.generate_occupancy << ", sort "
+              << stats.sort_occupancy << ", merge " << stats.merge_occupancy << ", verify "
+              << stats.verify_occupancy << std::endl;
+    results.emplace_back("pipeline_time", stats.seconds);
+    results.emplace_back("pipeline_throughput", throughput);
+    results.emplace_back("pipeline_generate_occupancy", stats.generate_occupancy);
+    results.emplace_back("pipeline_sort_occupancy", stats.sort_occupancy);
+    results.emplace_back("pipeline_merge_occupancy", stats.merge_occupancy);
+    results.emplace_back("pipeline_verify_occupancy", stats.verify_occupancy);
+    results.emplace_back("pipeline_keys", keys);
+}
+
+// Request handler for the benchmark service: pi(x) from a table built once at startup (by
+// sieving above it), F(n) by fast doubling (the service rejects n > kMaxServiceFibonacci) and
+// sorts with the radix sort through the worker's scratch buffer, so a sort allocates nothing
+ServiceHandler make_service_handler(uint64_t prime_table_limit) {
+    auto pi = std::make_shared<PrimePiTable>(prime_table_limit, g_num_threads);
+    return [pi](const ServiceRequest& request, std::vector<int>& keys,
+                std::vector<int>& scratch) -> uint64_t {
+        switch (static_cast<ServiceOp>(request.op)) {
+            case ServiceOp::Sort:
+                radix_sort(keys.begin(), keys.end(), scratch);
+                return keys.size();
+            case ServiceOp::CountPrimes:
+                return request.arg <= pi->limit() ? (*pi)(request.arg)
+                                                  : prime_pi_sieve(request.arg, 1);
+            default:
+                return fibonacci_pair(static_cast<int>(request.arg)).first;
         }
-        std::swap(arr[i + 1], arr[high]);
-        
-        int pi = i + 1;
+    };
+}
+
+BenchService* g_service = nullptr;
+
+// Runs the service until a Shutdown request, SIGINT or SIGTERM
+int serve(const std::string& path, size_t max_keys, uint64_t prime_table_limit) {
+    try {
+        BenchService service(path, g_num_threads, max_keys, make_service_handler(prime_table_limit));
+        g_service = &service;
+        auto on_signal = [](int) { g_service->stop(); };
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+        std::cout << "Serving on " << path << " with " << g_num_threads << " workers"
+                  << std::endl;
+        service.run();
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        g_service = nullptr;
+        std::cout << "Served " << service.requests() << " requests in " << service.batches()
+                  << " batches" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Service failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Puts the service under closed-loop load from `clients` connections and appends
+// "service_throughput" (requests/s), "service_p50_latency" and "service_p99_latency". Without a
+// `path` a service is started in this process on a temporary socket, which also gives the
+// mean batch size ("service_mean_batch").
+void run_service_test(std::string path, unsigned clients, size_t requests_per_client,
+                      size_t sort_keys, uint64_t prime_limit, uint64_t fib_n,
+                      const CounterRng& rng, ResultList& results) {
+    if (fib_n > kMaxServiceFibonacci) {
+        throw std::invalid_argument("--service-fib-n above " +
+                                    std::to_string(kMaxServiceFibonacci));
+    }
+    std::unique_ptr<BenchService> service;
+    std::thread server;
+    if (path.empty()) {
+        path = (std::filesystem::temp_directory_path() /
+                ("cpp_test_" + std::to_string(getpid()) + ".sock")).string();
+        service = std::make_unique<BenchService>(path, g_num_threads, sort_keys,
+                                                 make_service_handler(prime_limit));
+        server = std::thread([&service]() { service->run(); });
+    }
+    
+    ServiceLoadStats stats;
+    try {
+        stats = run_service_load(path, clients, requests_per_client, sort_keys, prime_limit,
+                                 fib_n, rng);
+    } catch (...) {
+        // Shut the in-process service down before the error leaves with a joinable thread
+        if (service) {
+            service->stop();
+            server.join();
+        }
+        throw;
+    }
+    double throughput = stats.requests / stats.seconds;
+    std::cout << "Requests: " << stats.requests << " from " << clients << " clients in "
+              << stats.seconds << " seconds (" << throughput << " requests/s)"
+              << (stats.ok ? "" : " (BAD REPLIES)") << std::endl;
+    std::cout << "Latency: p50 " << stats.p50_latency * 1e6 << " us, p99 "
+              << stats.p99_latency * 1e6 << " us, max " << stats.max_latency * 1e6 << " us"
+              << std::endl;
+    results.emplace_back("service_throughput", throughput);
+    results.emplace_back("service_p50_latency", stats.p50_latency);
+    results.emplace_back("service_p99_latency", stats.p99_latency);
+    results.emplace_back("service_requests", stats.requests);
+    
+    if (service) {
+        service->stop();
+        server.join();
+        double mean_batch = service->batches() ? double(service->requests()) / service->batches() : 0;
+        std::cout << "Mean batch: " << mean_batch << " requests" << std::endl;
+        results.emplace_back("service_mean_batch", mean_batch);
+    }
+}
+
+// Reads the int keys in `path` in blocks of `block`, handing each block to fn(data, n); returns
+// the number of keys read
+template <typename Fn>
+size_t scan_int_file(const std::string& path, size_t block, Fn&& fn) {
+    int fd = open_or_throw(path, O_RDONLY);
+    size_t total = file_size_or_throw(fd, path) / sizeof(int);
+    std::vector<int> buffer(std::min(block, total));
+    for (size_t begin = 0; begin < total; begin += block) {
+        size_t n = std::min(block, total - begin);
+        pread_all(fd, buffer.data(), n * sizeof(int), begin * sizeof(int));
+        fn(buffer.data(), n);
+    }
+    ::close(fd);
+    return total;
+}
+
+// Generates `count` int keys into a file under `dir`, sorts it out of core with a
+// `memory_budget` byte budget and appends the "external_sort_*" results. The output is checked
+// block by block (count, order and the input's checksum) before it is removed. When resuming
+// from a checkpoint, the input file and the run files of the interrupted sort are reused.
+void run_external_sort(size_t count, size_t memory_budget, const std::string& dir,
+                       const CounterRng& rng, ResultList& results) {
+    std::filesystem::create_directories(dir);
+    std::string input = dir + "/input.bin";
+    std::string output = dir + "/sorted.bin";
+    Checkpoint checkpoint = g_checkpoints.open(
+        "external_sort", checkpoint_fingerprint({count, memory_budget, rng.seed()}));
+    std::error_code error;
+    bool reuse_input = !checkpoint.restored().empty() &&
+                       std::filesystem::file_size(input, error) == count * sizeof(int);
+    
+    // Write the input in budget-sized chunks so generation also stays within the budget
+    size_t chunk = std::max<size_t>(1, memory_budget / sizeof(int));
+    std::vector<int> buffer;
+    uint64_t input_checksum = 0;
+    int fd = reuse_input ? -1 : open_or_throw(input, O_WRONLY | O_CREAT | O_TRUNC);
+    for (size_t begin = 0; fd >= 0 && begin < count; begin += chunk) {
+        buffer.resize(std::min(chunk, count - begin));
+        fill_uniform_int(buffer.data(), buffer.size(), begin, rng, 1, 1000000, g_num_threads);
+        input_checksum += dataset_checksum(buffer.data(), buffer.size(), g_num_threads);
+        write_all(fd, buffer.data(), buffer.size() * sizeof(int));
+    }
+    if (fd >= 0) ::close(fd);
+    std::vector<int>().swap(buffer);
+    if (reuse_input) {
+        scan_int_file(input, chunk, [&input_checksum](const int* data, size_t n) {
+            input_checksum += dataset_checksum(data, n, g_num_threads);
+        });
+    }
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    ExternalSortStats stats = external_sort<int>(input, output, memory_budget, dir,
+                                                 &checkpoint);
+    auto end = std::chrono::high_resolution_clock::now();
+    double total_time = std::chrono::duration<double>(end - start).count();
+    
+    bool sorted_ok = true;
+    int previous = std::numeric_limits<int>::min();
+    uint64_t output_checksum = 0;
+    size_t output_keys = scan_int_file(output, chunk, [&](const int* data, size_t n) {
+        sorted_ok = sorted_ok && previous <= data[0] && std::is_sorted(data, data + n);
+        previous = data[n - 1];
+        output_checksum += dataset_checksum(data, n, g_num_threads);
+    });
+    sorted_ok = sorted_ok && output_keys == count && output_checksum == input_checksum;
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+    
+    double io_gb = (stats.bytes_read + stats.bytes_written) / 1e9;
+    std::cout << "External Sort Time: " << total_time << " seconds (" << stats.runs
+              << " runs, " << stats.merge_passes << " merge passes, run phase "
+              << stats.run_time << " s, merge phase " << stats.merge_time << " s, "
+              << io_gb / total_time << " GB/s I/O)" << (sorted_ok ? "" : " (NOT SORTED)")
+              << std::endl;
+    if (checkpoint.enabled()) {
+        std::cout << "Checkpoints: " << stats.resumed_runs << " runs resumed, "
+                  << checkpoint.saves() << " saves in " << checkpoint.save_seconds()
+                  << " seconds" << std::endl;
+        results.emplace_back("external_sort_resumed_runs", stats.resumed_runs);
+        results.emplace_back("external_sort_checkpoint_time", checkpoint.save_seconds());
+    }
+    results.emplace_back("external_sort", total_time);
+    results.emplace_back("external_sort_run_phase", stats.run_time);
+    results.emplace_back("external_sort_merge_phase", stats.merge_time);
+    results.emplace_back("external_sort_runs", stats.runs);
+    results.emplace_back("external_sort_merge_passes", stats.merge_passes);
+    results.emplace_back("external_sort_keys", count);
+    results.emplace_back("external_sort_memory_budget_mb", memory_budget / (1024.0 * 1024.0));
+}
+
+// Tests `count` random 64-bit numbers for primality one at a time, in lane batches, and in
+// lane batches split across threads, appending the "primality_*" results
+void run_primality_queries(size_t count, const CounterRng& rng, ResultList& results) {
+    std::vector<uint64_t> queries(count);
+    parallel_generate(queries.data(), count, 0, g_num_threads,
+                      [&rng](uint64_t i) { return rng.bits(i); });
+    std::unique_ptr<bool[]> scalar_result(new bool[count]);
+    std::unique_ptr<bool[]> batch_result(new bool[count]);
+    std::unique_ptr<bool[]> parallel_result(new bool[count]);
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        scalar_result[i] = is_prime_u64(queries[i]);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double scalar_time = std::chrono::duration<double>(end - start).count();
+    
+    start = std::chrono::high_resolution_clock::now();
+    is_prime_batch(queries.data(), batch_result.get(), count);
+    end = std::chrono::high_resolution_clock::now();
+    double batch_time = std::chrono::duration<double>(end - start).count();
+    
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<std::future<void>> futures;
+    size_t chunk = (count + g_num_threads - 1) / g_num_threads;
+    for (size_t begin = 0; begin < count; begin += chunk) {
+        size_t len = std::min(chunk, count - begin);
+        futures.push_back(std::async(std::launch::async, [&, begin, len]() {
+            is_prime_batch(queries.data() + begin, parallel_result.get() + begin, len);
+        }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double parallel_time = std::chrono::duration<double>(end - start).count();
+    
+    size_t primes = 0;
+    bool consistent = true;
+    for (size_t i = 0; i < count; i++) {
+        primes += scalar_result[i];
+        consistent = consistent && batch_result[i] == scalar_result[i] &&
+                     parallel_result[i] == scalar_result[i];
+    }
+    if (!consistent) {
+        std::cerr << "Primality query results differ between kernels" << std::endl;
+    }
+    
+    std::cout << "Primality Queries: " << count << " numbers, " << primes << " prime" << std::endl;
+    std::cout << "Scalar Time: " << scalar_time << " seconds" << std::endl;
+    std::cout << "Batched Time: " << batch_time << " seconds" << std::endl;
+    std::cout << "Batched Parallel Time: " << parallel_time << " seconds" << std::endl;
+    results.emplace_back("primality_scalar", scalar_time);
+    results.emplace_back("primality_batch", batch_time);
+    results.emplace_back("primality_batch_parallel", parallel_time);
+    results.emplace_back("primality_queries", count);
+    results.emplace_back("primality_primes_found", primes);
+}
+
+// Compile-time specialized kernels (static_kernels.hpp) against the generic runtime ones:
+// `count` small sorts of 2 to 32 ints and doubles (network_sort through the dispatch table vs
+// quicksort_serial), `count` F(n) queries with n <= 93 (table vs the iterative recurrence) and
+// counting the primes <= prime_limit (210 wheel and prime table vs is_prime on every number).
+// Appends "static_<kernel>_generic" and "static_<kernel>_specialized".
+void run_static_kernels(size_t count, uint32_t prime_limit, const CounterRng& rng,
+                        ResultList& results) {
+    using clock = std::chrono::high_resolution_clock;
+    auto report = [&results](const std::string& kernel, const std::string& label, double generic,
+                             double specialized, bool consistent) {
+        std::cout << label << ": generic " << generic << " seconds, specialized " << specialized
+                  << " seconds (" << generic / specialized << "x)"
+                  << (consistent ? "" : " (RESULTS DIFFER)") << std::endl;
+        results.emplace_back("static_" + kernel + "_generic", generic);
+        results.emplace_back("static_" + kernel + "_specialized", specialized);
+    };
+    
+    // Arrays of 2 .. 32 elements back to back; the sizes come first in the counter space
+    std::vector<uint32_t> sizes(count);
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        sizes[i] = static_cast<uint32_t>(rng.uniform_int(i, 2, kMaxNetworkSize));
+        total += sizes[i];
+    }
+    auto sort_arrays = [&](auto&& generate, const std::string& kernel, const std::string& label) {
+        using T = decltype(generate(uint64_t(0)));
+        std::vector<T> generic(total);
+        for (size_t i = 0; i < total; i++) generic[i] = generate(count + i);
+        std::vector<T> specialized = generic;
+    
+        auto start = clock::now();
+        T* data = generic.data();
+        for (uint32_t n : sizes) {
+            quicksort_serial(data, data + n);
+            data += n;
+        }
+        double generic_time = std::chrono::duration<double>(clock::now() - start).count();
+    
+        start = clock::now();
+        data = specialized.data();
+        for (uint32_t n : sizes) {
+            small_sort(data, n);
+            data += n;
+        }
+        double specialized_time = std::chrono::duration<double>(clock::now() - start).count();
+        report(kernel, label, generic_time, specialized_time, generic == specialized);
+    };
+    sort_arrays([&rng](uint64_t i) { return static_cast<int>(rng.uniform_int(i, 1, 1000000)); },
+                "sort_int", "Small Sorts (int)");
+    sort_arrays([&rng](uint64_t i) { return rng.uniform_real(i); }, "sort_double",
+                "Small Sorts (double)");
+    
+    std::vector<int> fib_queries(count);
+    for (size_t i = 0; i < count; i++) {
+        fib_queries[i] = static_cast<int>(rng.uniform_int(count + total + i, 0, 93));
+    }
+    // The generic side keeps only the last two values (fibonacci_dynamic would also time a heap
+    // allocation per query), so the table is measured against n additions
+    auto fibonacci_iterative = [](int n) {
+        unsigned long long a = 0, b = 1;
+        for (int i = 0; i < n; i++) {
+            unsigned long long next = a + b;
+            a = b;
+            b = next;
+        }
+        return a;
+    };
+    auto start = clock::now();
+    unsigned long long generic_sum = 0;
+    for (int n : fib_queries) generic_sum += fibonacci_iterative(n);
+    double generic_time = std::chrono::duration<double>(clock::now() - start).count();
+    start = clock::now();
+    unsigned long long specialized_sum = 0;
+    for (int n : fib_queries) specialized_sum += fibonacci_static(n);
+    double specialized_time = std::chrono::duration<double>(clock::now() - start).count();
+    report("fibonacci", "Fibonacci Queries", generic_time, specialized_time,
+           generic_sum == specialized_sum);
+    
+    start = clock::now();
+    uint64_t generic_count = 0;
+    for (uint32_t n = 2; n <= prime_limit && n != 0; n++) generic_count += is_prime(n);
+    generic_time = std::chrono::duration<double>(clock::now() - start).count();
+    start = clock::now();
+    uint64_t specialized_count = count_primes_static(prime_limit);
+    specialized_time = std::chrono::duration<double>(clock::now() - start).count();
+    report("primes", "Primes <= " + std::to_string(prime_limit), generic_time, specialized_time,
+           generic_count == specialized_count);
+    results.emplace_back("static_queries", count);
+    results.emplace_back("static_prime_limit", prime_limit);
+}
+
+// Streams the primes <= limit from the sieve workers to a consumer (prime_stream.hpp) and,
+// for comparison, collects them all before consuming. The consumer counts and checksums them.
+// Appends "prime_stream_*" (total time, time to the first prime, primes per second) and the
+// same for "prime_stream_collect_*".
+void run_prime_stream(uint64_t limit, ResultList& results) {
+    using clock = std::chrono::high_resolution_clock;
+    uint64_t expected = prime_pi_sieve(limit, g_num_threads);
+    
+    for (bool stream : {true, false}) {
+        uint64_t count = 0, checksum = 0;
+        double first_latency = -1;
+        auto start = clock::now();
+        stream_primes(limit, g_num_threads, stream, [&](const std::vector<uint64_t>& primes) {
+            if (first_latency < 0 && !primes.empty()) {
+                first_latency = std::chrono::duration<double>(clock::now() - start).count();
+            }
+            for (uint64_t p : primes) {
+                checksum += p;
+            }
+            count += primes.size();
+        });
+        double total_time = std::chrono::duration<double>(clock::now() - start).count();
+        double throughput = count / total_time;
         
-        std::future<void> left_sort = std::async(std::launch::async,
-            [&arr, low, pi, depth]() {
-                quicksort_parallel(arr, low, pi - 1, depth + 1);
-            });
-            
-        quicksort_parallel(arr, pi + 1, high, depth + 1);
-        left_sort.wait();
+        std::string prefix = stream ? "prime_stream" : "prime_stream_collect";
+        std::cout << (stream ? "Streaming: " : "Collect first: ") << total_time
+                  << " seconds, first prime after " << first_latency << " seconds, "
+                  << throughput << " primes/s" << (count == expected ? "" : " (COUNT MISMATCH)")
+                  << " (checksum " << checksum << ")" << std::endl;
+        results.emplace_back(prefix + "_time", total_time);
+        if (first_latency >= 0) {
+            results.emplace_back(prefix + "_first_latency", first_latency);
+        }
+        results.emplace_back(prefix + "_throughput", throughput);
+    }
+    results.emplace_back("prime_stream_limit", limit);
+    results.emplace_back("prime_stream_count", expected);
+}
+
+// Sweeps pi(x) and F(n) over `points` evenly spaced points up to prime_limit and fib_n, once
+// from scratch at every point and once with the incremental engines (incremental_cache.hpp),
+// which only compute what the previous point did not. With a cache_dir the engines also keep
+// their state in cache files there, so a later run starts from where this one stopped.
+// The from-scratch prime sweep is checkpointed point by point (its elapsed time first).
+// Appends "sweep_primes_*" and "sweep_fibonacci_*".
+void run_sweep(uint64_t prime_limit, int fib_n, int points, const std::string& cache_dir,
+               ResultList& results) {
+    using clock = std::chrono::high_resolution_clock;
+    points = std::max(1, points);
+    
+    Checkpoint checkpoint = g_checkpoints.open(
+        "sweep", checkpoint_fingerprint({prime_limit, static_cast<uint64_t>(points)}));
+    std::vector<uint64_t> state = checkpoint.restored();
+    if (state.empty() || state.size() > static_cast<size_t>(points) + 1) state = {0};
+    if (state.size() > 1) {
+        std::cout << "Resuming the sweep after " << state.size() - 1 << " points" << std::endl;
+    }
+    auto start = clock::now();
+    double resumed_time = word_to_double(state[0]);
+    for (int i = static_cast<int>(state.size()); i <= points; i++) {
+        state.push_back(prime_pi_sieve(prime_limit * i / points, g_num_threads));
+        state[0] = double_to_word(resumed_time +
+                                  std::chrono::duration<double>(clock::now() - start).count());
+        checkpoint.save(state);
+    }
+    std::vector<uint64_t> scratch_pi(state.begin() + 1, state.end());
+    double primes_scratch = word_to_double(state[0]);
+    checkpoint.finish();
+    
+    start = clock::now();
+    std::vector<unsigned long long> scratch_fib;
+    for (int i = 1; i <= points; i++) {
+        scratch_fib.push_back(fibonacci_dynamic(static_cast<int>(int64_t(fib_n) * i / points)));
+    }
+    double fibonacci_scratch = std::chrono::duration<double>(clock::now() - start).count();
+    
+    // Runs both sweeps on the given engines; returns their times, or -1 on a wrong value
+    auto sweep = [&](IncrementalPrimes& primes, IncrementalFibonacci& fibonacci) {
+        auto start = clock::now();
+        bool correct = true;
+        for (int i = 1; i <= points; i++) {
+            correct = correct && primes.pi(prime_limit * i / points) == scratch_pi[i - 1];
+        }
+        double primes_time = std::chrono::duration<double>(clock::now() - start).count();
+    
+        start = clock::now();
+        for (int i = 1; i <= points; i++) {
+            correct = correct && fibonacci(int64_t(fib_n) * i / points) == scratch_fib[i - 1];
+        }
+        double fibonacci_time = std::chrono::duration<double>(clock::now() - start).count();
+        if (!correct) {
+            std::cerr << "Incremental sweep disagrees with the from-scratch values" << std::endl;
+            return std::make_pair(-1.0, -1.0);
+        }
+        return std::make_pair(primes_time, fibonacci_time);
+    };
+    
+    IncrementalPrimes primes(g_num_threads);
+    IncrementalFibonacci fibonacci;
+    auto [primes_incremental, fibonacci_incremental] = sweep(primes, fibonacci);
+    
+    std::cout << points << " points up to pi(" << prime_limit << ") and F(" << fib_n << ")"
+              << std::endl;
+    std::cout << "Primes From Scratch: " << primes_scratch << " seconds, incremental: "
+              << primes_incremental << " seconds" << std::endl;
+    std::cout << "Fibonacci From Scratch: " << fibonacci_scratch << " seconds, incremental: "
+              << fibonacci_incremental << " seconds" << std::endl;
+    results.emplace_back("sweep_primes_scratch", primes_scratch);
+    results.emplace_back("sweep_primes_incremental", primes_incremental);
+    results.emplace_back("sweep_fibonacci_scratch", fibonacci_scratch);
+    results.emplace_back("sweep_fibonacci_incremental", fibonacci_incremental);
+    
+    if (!cache_dir.empty()) {
+        std::filesystem::create_directories(cache_dir);
+        IncrementalPrimes cached_primes(cache_dir + "/primes.cache", g_num_threads);
+        IncrementalFibonacci cached_fibonacci(cache_dir + "/fibonacci.cache");
+        uint64_t primes_known = cached_primes.covered();
+        size_t fibonacci_known = cached_fibonacci.known();
+        auto [primes_cached, fibonacci_cached] = sweep(cached_primes, cached_fibonacci);
+        std::cout << "Cache File (primes to " << primes_known << ", " << fibonacci_known
+                  << " Fibonacci numbers already known): primes " << primes_cached
+                  << " seconds, Fibonacci " << fibonacci_cached << " seconds" << std::endl;
+        results.emplace_back("sweep_primes_cached", primes_cached);
+        results.emplace_back("sweep_fibonacci_cached", fibonacci_cached);
+    }
+    results.emplace_back("sweep_points", points);
+    results.emplace_back("sweep_prime_limit", prime_limit);
+    results.emplace_back("sweep_fib_n", fib_n);
+}
+
+// Counts the primes <= limit by enumerating them (find_primes_parallel), by popcounting
+// sieve blocks and by Meissel–Lehmer, appending the "prime_count_*" results
+void run_prime_counting(uint64_t limit, ResultList& results) {
+    using clock = std::chrono::high_resolution_clock;
+    
+    // The enumerating kernels work on int
+    double enumerate_time = -1;
+    uint64_t enumerated = 0;
+    if (limit <= static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+        auto start = clock::now();
+        enumerated = find_primes_parallel(static_cast<int>(limit)).size();
+        enumerate_time = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    
+    // With checkpointing, the sieve counts save their finished slices and a resumed run
+    // sieves only the others (the times then cover this run only)
+    double checkpoint_time = 0;
+    auto sieve_count = [&](unsigned threads, const char* name) {
+        Checkpoint checkpoint = g_checkpoints.open(name, checkpoint_fingerprint({limit}));
+        if (!checkpoint.enabled()) return prime_pi_sieve(limit, threads);
+        uint64_t count = count_primes_checkpointed(
+            0, limit + 1, base_primes(static_cast<uint32_t>(isqrt(limit))), threads, checkpoint);
+        checkpoint_time += checkpoint.save_seconds();
+        return count;
+    };
+    
+    auto start = clock::now();
+    uint64_t sieve_serial = sieve_count(1, "prime_count_serial");
+    double sieve_serial_time = std::chrono::duration<double>(clock::now() - start).count();
+    
+    start = clock::now();
+    uint64_t sieve_parallel = sieve_count(g_num_threads, "prime_count_parallel");
+    double sieve_parallel_time = std::chrono::duration<double>(clock::now() - start).count();
+    
+    start = clock::now();
+    uint64_t meissel_serial = prime_pi_meissel(limit, 1);
+    double meissel_serial_time = std::chrono::duration<double>(clock::now() - start).count();
+    
+    start = clock::now();
+    uint64_t meissel_parallel = prime_pi_meissel(limit, g_num_threads);
+    double meissel_parallel_time = std::chrono::duration<double>(clock::now() - start).count();
+    
+    bool consistent = sieve_parallel == sieve_serial && meissel_serial == sieve_serial &&
+                      meissel_parallel == sieve_serial &&
+                      (enumerate_time < 0 || enumerated == sieve_serial);
+    if (!consistent) {
+        std::cerr << "Prime counts differ between kernels" << std::endl;
+    }
+    
+    std::cout << "pi(" << limit << ") = " << sieve_serial << std::endl;
+    if (enumerate_time >= 0) {
+        std::cout << "Enumerate Time: " << enumerate_time << " seconds" << std::endl;
+    }
+    std::cout << "Sieve Count Serial Time: " << sieve_serial_time << " seconds" << std::endl;
+    std::cout << "Sieve Count Parallel Time: " << sieve_parallel_time << " seconds" << std::endl;
+    if (!g_checkpoints.dir.empty()) {
+        std::cout << "Checkpoint Time: " << checkpoint_time << " seconds" << std::endl;
+        results.emplace_back("prime_count_checkpoint_time", checkpoint_time);
+    }
+    std::cout << "Meissel-Lehmer Serial Time: " << meissel_serial_time << " seconds" << std::endl;
+    std::cout << "Meissel-Lehmer Parallel Time: " << meissel_parallel_time << " seconds"
+              << std::endl;
+    if (enumerate_time >= 0) {
+        results.emplace_back("prime_count_enumerate", enumerate_time);
     }
+    results.emplace_back("prime_count_sieve_serial", sieve_serial_time);
+    results.emplace_back("prime_count_sieve_parallel", sieve_parallel_time);
+    results.emplace_back("prime_count_meissel_serial", meissel_serial_time);
+    results.emplace_back("prime_count_meissel_parallel", meissel_parallel_time);
+    results.emplace_back("prime_count_limit", limit);
+    results.emplace_back("prime_count", sieve_serial);
+}
+
+// Starts allocation accounting for one kernel, first reclaiming the arena if one is in use
+AllocScope begin_kernel(KernelArena* arena) {
+    if (arena) arena->reset();
+    return AllocScope();
+}
+
+// Runs the parallel Fibonacci, prime and sort kernels on OpenMP instead of std::async
+// (--backend openmp, needs a -fopenmp build)
+bool g_use_openmp = false;
+
+std::pmr::vector<unsigned long long> fibonacci_backend(int n, std::pmr::memory_resource* resource) {
+#ifdef _OPENMP
+    if (g_use_openmp) return fibonacci_openmp(n, resource);
+#endif
+    return fibonacci_parallel(n, resource);
+}
+
+std::pmr::vector<int> find_primes_backend(int limit, std::pmr::memory_resource* resource) {
+#ifdef _OPENMP
+    if (g_use_openmp) return find_primes_openmp(limit, resource);
+#endif
+    return find_primes_parallel(limit, resource);
+}
+
+template <typename RandomIt>
+void quicksort_backend(RandomIt first, RandomIt last) {
+#ifdef _OPENMP
+    if (g_use_openmp) return quicksort_openmp(first, last);
+#endif
+    quicksort_parallel(first, last);
 }
 
 int main(int argc, char* argv[]) {
     // Set thread count from command line argument if provided
-    if (argc > 1) {
+    if (argc > 1 && !is_option(argv[1])) {
         set_thread_count(std::stoi(argv[1]));
     }
     std::cout << "Running with " << g_num_threads << " threads" << std::endl;
     
+    std::string backend = get_option(argc, argv, "--backend", "async");
+    g_use_openmp = backend == "openmp";
+#ifdef _OPENMP
+    omp_set_num_threads(g_num_threads);
+    std::string schedule = get_option(argc, argv, "--omp-schedule", "dynamic");
+    omp_set_schedule(schedule == "guided" ? omp_sched_guided : omp_sched_dynamic, 0);
+#else
+    if (g_use_openmp) {
+        std::cout << "OpenMP backend not built in (compile with -fopenmp), using std::async"
+                  << std::endl;
+        g_use_openmp = false;
+    }
+#endif
+    std::cout << "Parallel backend: " << (g_use_openmp ? "openmp" : "async") << std::endl;
+    
+    // --checkpoint-dir DIR saves the progress of the long kernels (prime count, sweep, external
+    // sort) every --checkpoint-interval seconds; --resume continues from those files
+    g_checkpoints.resume = has_flag(argc, argv, "--resume");
+    g_checkpoints.dir = get_option(argc, argv, "--checkpoint-dir",
+                                   g_checkpoints.resume ? "checkpoints" : "");
+    g_checkpoints.interval_seconds = std::stod(get_option(argc, argv, "--checkpoint-interval", "60"));
+    if (!g_checkpoints.dir.empty()) std::filesystem::create_directories(g_checkpoints.dir);
+    
+    // Daemon mode: keep the workers and tables warm and answer requests over a socket instead
+    // of running the benchmarks
+    std::string socket_path = get_option(argc, argv, "--socket");
+    if (has_flag(argc, argv, "--serve")) {
+        if (socket_path.empty()) {
+            socket_path = (std::filesystem::temp_directory_path() / "cpp_test.sock").string();
+        }
+        return serve(socket_path,
+                     std::stoull(get_option(argc, argv, "--service-max-keys", "1048576")),
+                     std::stoull(get_option(argc, argv, "--service-prime-table", "10000000")));
+    }
+    
+    // --dataset PATH sorts a saved input (bench_dataset.hpp), mapped rather than regenerated,
+    // and takes its size and seed from it; if PATH does not exist yet, the input is saved there
+    std::string dataset_path = get_option(argc, argv, "--dataset");
+    std::optional<MappedDataset<int32_t>> dataset;
+    if (!dataset_path.empty() && std::filesystem::exists(dataset_path)) {
+        try {
+            dataset.emplace(dataset_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        // The sort kernels index with int
+        if (dataset->size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+            std::cerr << dataset_path << ": " << dataset->size()
+                      << " keys exceed the sort size limit of "
+                      << std::numeric_limits<int>::max() << std::endl;
+            return 1;
+        }
+    }
+    
     const int PRIME_LIMIT = 100000;
-    const int SORT_SIZE = 1000000;
+    const int SORT_SIZE = dataset ? static_cast<int>(dataset->size())
+                                  : std::stoi(get_option(argc, argv, "--sort-size", "1000000"));
     const int FIB_N = 100000;
     
+    ResultList extra_results;
+    
+    // With --arena the kernels allocate from a preallocated per-thread arena instead of the heap
+    KernelArena* arena = nullptr;
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+    if (has_flag(argc, argv, "--arena")) {
+        arena = &thread_arena(std::stoull(get_option(argc, argv, "--arena-mb", "64")) << 20);
+        resource = arena;
+    }
+    
+    // Input data is a pure function of the seed, so runs can be reproduced with --seed
+    std::string seed_arg = get_option(argc, argv, "--seed");
+    const uint64_t seed = dataset ? dataset->seed()
+                        : seed_arg.empty() ? random_seed() : std::stoull(seed_arg);
+    
     // Create logs directory if it doesn't exist
     std::filesystem::create_directory("logs");
     
@@ -173,72 +1111,300 @@ int main(int argc, char* argv[]) {
     double serial_time_primes, parallel_time_primes;
     double serial_time_sort, parallel_time_sort;
     
-    // Fibonacci test
+    // Fibonacci test. Each kernel's result lives in a block of its own: the next begin_kernel()
+    // reclaims the --arena memory it points into.
     std::cout << "\nC++ Fibonacci Test" << std::endl;
     
-    auto start = std::chrono::high_resolution_clock::now();
-    auto fib_serial = fibonacci_dynamic(FIB_N);
-    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::high_resolution_clock::time_point start, end;
+    AllocScope alloc = begin_kernel(arena);
+    {
+        start = std::chrono::high_resolution_clock::now();
+        auto fib_serial = fibonacci_dynamic(FIB_N, resource);
+        end = std::chrono::high_resolution_clock::now();
+    }
     serial_time_fib = std::chrono::duration<double>(end - start).count();
-    std::cout << "Serial Time (Dynamic): " << serial_time_fib << " seconds" << std::endl;
+    std::cout << "Serial Time (Dynamic): " << serial_time_fib << " seconds ("
+              << alloc << ")" << std::endl;
+    record_allocations(extra_results, "fibonacci_serial", alloc);
     
-    start = std::chrono::high_resolution_clock::now();
-    auto fib_parallel = fibonacci_parallel(FIB_N);
-    end = std::chrono::high_resolution_clock::now();
+    alloc = begin_kernel(arena);
+    {
+        start = std::chrono::high_resolution_clock::now();
+        auto fib_parallel = fibonacci_backend(FIB_N, resource);
+        end = std::chrono::high_resolution_clock::now();
+    }
     parallel_time_fib = std::chrono::duration<double>(end - start).count();
-    std::cout << "Parallel Time: " << parallel_time_fib << " seconds" << std::endl;
+    std::cout << "Parallel Time: " << parallel_time_fib << " seconds ("
+              << alloc << ")" << std::endl;
+    record_allocations(extra_results, "fibonacci_parallel", alloc);
     
     // Prime numbers test
     std::cout << "\nC++ Prime Numbers Test" << std::endl;
     
-    start = std::chrono::high_resolution_clock::now();
-    auto primes_serial = find_primes_serial(PRIME_LIMIT);
-    end = std::chrono::high_resolution_clock::now();
+    alloc = begin_kernel(arena);
+    {
+        start = std::chrono::high_resolution_clock::now();
+        auto primes_serial = find_primes_serial(PRIME_LIMIT, resource);
+        end = std::chrono::high_resolution_clock::now();
+    }
     serial_time_primes = std::chrono::duration<double>(end - start).count();
-    std::cout << "Serial Time: " << serial_time_primes << " seconds" << std::endl;
+    std::cout << "Serial Time: " << serial_time_primes << " seconds ("
+              << alloc << ")" << std::endl;
+    record_allocations(extra_results, "primes_serial", alloc);
     
-    start = std::chrono::high_resolution_clock::now();
-    auto primes_parallel = find_primes_parallel(PRIME_LIMIT);
-    end = std::chrono::high_resolution_clock::now();
+    // --output-dir DIR keeps the primes and the sorted array as datasets for later runs; the
+    // primes are written while they are still in scope
+    std::string output_dir = get_option(argc, argv, "--output-dir");
+    alloc = begin_kernel(arena);
+    {
+        start = std::chrono::high_resolution_clock::now();
+        auto primes_parallel = find_primes_backend(PRIME_LIMIT, resource);
+        end = std::chrono::high_resolution_clock::now();
+        if (!output_dir.empty()) {
+            std::filesystem::create_directories(output_dir);
+            write_dataset<int32_t>(output_dir + "/primes.bin", primes_parallel.data(),
+                                   primes_parallel.size(), 0);
+        }
+    }
     parallel_time_primes = std::chrono::duration<double>(end - start).count();
-    std::cout << "Parallel Time: " << parallel_time_primes << " seconds" << std::endl;
+    std::cout << "Parallel Time: " << parallel_time_primes << " seconds ("
+              << alloc << ")" << std::endl;
+    record_allocations(extra_results, "primes_parallel", alloc);
+    
+    // Prime counting test: pi(x) only, without materializing the primes
+    std::cout << "\nC++ Prime Counting Test" << std::endl;
+    
+    uint64_t count_limit = std::stoull(get_option(argc, argv, "--prime-count-limit", "10000000"));
+    run_prime_counting(count_limit, extra_results);
+    
+    // Prime streaming test: primes handed to a consumer while the sieve is still running
+    std::cout << "\nC++ Prime Stream Test" << std::endl;
+    
+    uint64_t stream_limit = std::stoull(get_option(argc, argv, "--prime-stream-limit", "100000000"));
+    run_prime_stream(stream_limit, extra_results);
+    
+    // Sweep test: growing limits from scratch vs. extending the previous point's state
+    std::cout << "\nC++ Sweep Test" << std::endl;
+    
+    run_sweep(std::stoull(get_option(argc, argv, "--sweep-prime-limit", "100000000")),
+              std::stoi(get_option(argc, argv, "--sweep-fib-n", "1000000")),
+              std::stoi(get_option(argc, argv, "--sweep-points", "8")),
+              get_option(argc, argv, "--cache-dir"), extra_results);
     
     // QuickSort test
     std::cout << "\nC++ QuickSort Test" << std::endl;
     
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(1, 1000000);
+    // Sort buffers are mapped with the --pages policy (regular, thp or hugetlb) and
+    // pre-faulted, so page faults stay out of the sort timings
+    PagePolicy requested_pages = parse_page_policy(get_option(argc, argv, "--pages", "regular"));
+    start = std::chrono::high_resolution_clock::now();
+    PageBuffer<int> test_array(SORT_SIZE, requested_pages);
+    PageBuffer<int> array_copy(SORT_SIZE, requested_pages);
+    end = std::chrono::high_resolution_clock::now();
+    double prefault_time = std::chrono::duration<double>(end - start).count();
+    std::cout << "Buffer Pages: " << page_policy_name(test_array.policy()) << " (prefault "
+              << prefault_time << " seconds)" << std::endl;
+    extra_results.emplace_back("sort_buffer_prefault", prefault_time);
     
-    std::vector<int> test_array(SORT_SIZE);
-    for (int i = 0; i < SORT_SIZE; i++) {
-        test_array[i] = dis(gen);
+    DtlbMissCounter dtlb;
+    if (!dtlb.available()) {
+        std::cout << "dTLB miss counter unavailable (perf_event_open not permitted)" << std::endl;
     }
-    auto array_copy = test_array;
     
+    double generate_time;
     start = std::chrono::high_resolution_clock::now();
-    quicksort_serial(test_array, 0, test_array.size() - 1);
+    if (dataset) {
+        std::copy(dataset->begin(), dataset->end(), test_array.begin());
+    } else {
+        fill_uniform_int(test_array.data(), SORT_SIZE, 0, CounterRng(seed), 1, 1000000,
+                         g_num_threads);
+    }
     end = std::chrono::high_resolution_clock::now();
+    generate_time = std::chrono::duration<double>(end - start).count();
+    std::cout << (dataset ? "Data Load Time: " : "Data Generation Time: ") << generate_time
+              << " seconds (seed " << seed << ")" << std::endl;
+    std::copy(test_array.begin(), test_array.end(), array_copy.begin());
+    
+    // The order-independent checksum of the input also checks the sorted output later
+    uint64_t input_checksum = 0;
+    if (!dataset_path.empty() || !output_dir.empty()) {
+        input_checksum = dataset_checksum(test_array.data(), SORT_SIZE, g_num_threads);
+    }
+    if (dataset && input_checksum != dataset->checksum()) {
+        std::cerr << "Dataset " << dataset_path << " fails its checksum" << std::endl;
+        return 1;
+    }
+    if (!dataset_path.empty() && !dataset) {
+        write_dataset(dataset_path, test_array.data(), SORT_SIZE, seed, g_num_threads);
+        std::cout << "Saved sort input to " << dataset_path << std::endl;
+    }
+    
+    alloc = begin_kernel(arena);
+    dtlb.start();
+    start = std::chrono::high_resolution_clock::now();
+    quicksort_serial(test_array.begin(), test_array.end());
+    end = std::chrono::high_resolution_clock::now();
+    long long dtlb_misses = dtlb.stop();
     serial_time_sort = std::chrono::duration<double>(end - start).count();
-    std::cout << "Serial Time: " << serial_time_sort << " seconds" << std::endl;
+    std::cout << "Serial Time: " << serial_time_sort << " seconds ("
+              << alloc << ")" << std::endl;
+    record_allocations(extra_results, "sort_serial", alloc);
+    if (dtlb.available()) {
+        std::cout << "  dTLB misses: " << dtlb_misses << std::endl;
+        extra_results.emplace_back("sort_serial_dtlb_misses", dtlb_misses);
+    }
     
+    alloc = begin_kernel(arena);
+    dtlb.start();
     start = std::chrono::high_resolution_clock::now();
-    quicksort_parallel(array_copy, 0, array_copy.size() - 1);
+    quicksort_backend(array_copy.begin(), array_copy.end());
     end = std::chrono::high_resolution_clock::now();
+    dtlb_misses = dtlb.stop();
     parallel_time_sort = std::chrono::duration<double>(end - start).count();
-    std::cout << "Parallel Time: " << parallel_time_sort << " seconds" << std::endl;
+    std::cout << "Parallel Time: " << parallel_time_sort << " seconds ("
+              << alloc << ")" << std::endl;
+    record_allocations(extra_results, "sort_parallel", alloc);
+    if (dtlb.available()) {
+        std::cout << "  dTLB misses: " << dtlb_misses << std::endl;
+        extra_results.emplace_back("sort_parallel_dtlb_misses", dtlb_misses);
+    }
+    
+    if (!output_dir.empty()) {
+        if (dataset_checksum(array_copy.data(), SORT_SIZE, g_num_threads) != input_checksum) {
+            std::cerr << "Sorted output is not a permutation of the input" << std::endl;
+        }
+        write_dataset(output_dir + "/sorted.bin", array_copy.data(), SORT_SIZE, seed,
+                      g_num_threads);
+        std::cout << "Saved sorted output and primes to " << output_dir << std::endl;
+    }
+    
+    // Stable parallel merge sort on the same input, regenerated from the seed or reloaded
+    if (dataset) {
+        std::copy(dataset->begin(), dataset->end(), array_copy.begin());
+    } else {
+        fill_uniform_int(array_copy.data(), SORT_SIZE, 0, CounterRng(seed), 1, 1000000,
+                         g_num_threads);
+    }
+    alloc = begin_kernel(arena);
+    start = std::chrono::high_resolution_clock::now();
+    merge_sort_parallel(array_copy.begin(), array_copy.end());
+    end = std::chrono::high_resolution_clock::now();
+    double merge_time_sort = std::chrono::duration<double>(end - start).count();
+    std::cout << "Parallel Merge Sort Time: " << merge_time_sort << " seconds (" << alloc << ")"
+              << std::endl;
+    extra_results.emplace_back("sort_merge_parallel", merge_time_sort);
+    record_allocations(extra_results, "sort_merge_parallel", alloc);
+    
+    // Typed sort test: the same engine over other key types and records
+    std::cout << "\nC++ Typed Sort Test" << std::endl;
+    
+    CounterRng rng(seed);
+    run_typed_sort<int32_t>("int32", SORT_SIZE,
+        [&rng](uint64_t i) { return static_cast<int32_t>(rng.bits(i)); },
+        std::less<>(), extra_results);
+    run_typed_sort<int64_t>("int64", SORT_SIZE,
+        [&rng](uint64_t i) { return static_cast<int64_t>(rng.bits(i)); },
+        std::less<>(), extra_results);
+    run_typed_sort<double>("double", SORT_SIZE,
+        [&rng](uint64_t i) { return rng.uniform_real(i) * 2.0 - 1.0; },
+        std::less<>(), extra_results);
+    run_typed_sort<Record>("record16", SORT_SIZE,
+        [&rng](uint64_t i) { return Record{rng.bits(i), i}; },
+        [](const Record& a, const Record& b) { return a.key < b.key; }, extra_results);
+
+    // Adversarial sort test: inputs that used to send quicksort quadratic (or overflow the
+    // stack) before it became an introsort
+    std::cout << "\nC++ Adversarial Sort Test" << std::endl;
+    run_adversarial_sorts(SORT_SIZE, rng, extra_results);
+    
+    // Pipeline test: the sort as streaming stages connected by bounded rings
+    std::cout << "\nC++ Pipeline Test" << std::endl;
+    run_pipeline(std::stoull(get_option(argc, argv, "--pipeline-keys", "10000000")),
+                 std::stoull(get_option(argc, argv, "--pipeline-block", "65536")),
+                 std::stoull(get_option(argc, argv, "--pipeline-fan-in", "8")), seed,
+                 extra_results);
+    
+    // Coroutine task runtime: fork/join overhead and the sorts ported onto it
+    std::cout << "\nC++ Coroutine Task Test" << std::endl;
+    run_coroutine_tasks(SORT_SIZE, seed, extra_results);
+    
+    // Standard library baseline: the same kernels written with C++17 parallel algorithms
+    std::cout << "\nC++ Standard Parallel Algorithms Test" << std::endl;
+    run_std_parallel(FIB_N, PRIME_LIMIT, SORT_SIZE, seed, extra_results);
+    
+    // Primality query test: sparse random 64-bit numbers rather than a dense range
+    std::cout << "\nC++ Primality Query Test" << std::endl;
+
+    size_t primality_queries = std::stoull(get_option(argc, argv, "--primality-queries", "1000000"));
+    run_primality_queries(primality_queries, rng, extra_results);
+    
+    // Compile-time specialization test: constexpr tables and fixed-size kernels vs the
+    // runtime-parameterized ones
+    std::cout << "\nC++ Compile-Time Specialization Test" << std::endl;
+    
+    run_static_kernels(std::stoull(get_option(argc, argv, "--static-queries", "1000000")),
+                       static_cast<uint32_t>(std::min<uint64_t>(
+                           std::stoull(get_option(argc, argv, "--static-prime-limit", "1000000")),
+                           UINT32_MAX)),
+                       rng, extra_results);
+
+    // External (out-of-core) sort test, opt-in since it writes to local disk
+    if (has_flag(argc, argv, "--external-sort")) {
+        std::cout << "\nC++ External Sort Test" << std::endl;
+        
+        size_t external_size = std::stoull(
+            get_option(argc, argv, "--external-size", std::to_string(SORT_SIZE)));
+        size_t memory_budget = std::stoull(get_option(argc, argv, "--memory-budget", "64")) << 20;
+        std::string external_dir = get_option(argc, argv, "--external-dir",
+            (std::filesystem::temp_directory_path() / "cpp_external_sort").string());
+        try {
+            run_external_sort(external_size, memory_budget, external_dir, rng, extra_results);
+        } catch (const std::exception& e) {
+            std::cerr << "External sort failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+    // Service test, opt-in: request latency and throughput under concurrent load, against
+    // the daemon at --socket or one started in this process
+    if (has_flag(argc, argv, "--service-test")) {
+        std::cout << "\nC++ Service Test" << std::endl;
+        
+        try {
+            run_service_test(socket_path,
+                             std::stoul(get_option(argc, argv, "--service-clients",
+                                                   std::to_string(2 * g_num_threads))),
+                             std::stoull(get_option(argc, argv, "--service-requests", "1000")),
+                             std::stoull(get_option(argc, argv, "--service-sort-keys", "10000")),
+                             std::stoull(get_option(argc, argv, "--service-prime-limit", "1000000")),
+                             std::stoull(get_option(argc, argv, "--service-fib-n", "93")),
+                             rng, extra_results);
+        } catch (const std::exception& e) {
+            std::cerr << "Service test failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
     
     // Write results to JSON file
-    std::ofstream log_file("logs/cpp_results.json");
+    // OpenMP runs are logged as their own language so both backends can be compared
+    std::ofstream log_file(g_use_openmp ? "logs/cpp_openmp_results.json" : "logs/cpp_results.json");
     log_file << "{\n";
-    log_file << "  \"language\": \"C++\",\n";
+    log_file << "  \"language\": \"" << (g_use_openmp ? "C++ (OpenMP)" : "C++") << "\",\n";
+    log_file << "  \"parallel_backend\": \"" << (g_use_openmp ? "openmp" : "async") << "\",\n";
     log_file << "  \"thread_count\": " << g_num_threads << ",\n";
+    log_file << "  \"seed\": " << seed << ",\n";
+    log_file << "  \"sort_size\": " << SORT_SIZE << ",\n";
+    log_file << "  \"arena\": " << (arena ? "true" : "false") << ",\n";
+    log_file << "  \"page_policy\": \"" << page_policy_name(test_array.policy()) << "\",\n";
+    log_file << "  \"data_generation\": " << generate_time << ",\n";
     log_file << "  \"fibonacci_serial\": " << serial_time_fib << ",\n";
     log_file << "  \"fibonacci_parallel\": " << parallel_time_fib << ",\n";
     log_file << "  \"primes_serial\": " << serial_time_primes << ",\n";
     log_file << "  \"primes_parallel\": " << parallel_time_primes << ",\n";
     log_file << "  \"sort_serial\": " << serial_time_sort << ",\n";
-    log_file << "  \"sort_parallel\": " << parallel_time_sort << "\n";
+    log_file << "  \"sort_parallel\": " << parallel_time_sort;
+    write_result_fields(log_file, extra_results);
+    log_file << "\n";
     log_file << "}\n";
     log_file.close();
     
@@ -3,24 +3,271 @@
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <array>
+#include <climits>
 #include <fstream>
 #include <filesystem>
 #include <mpi.h>
 #include <cmath>
+#include <cstring>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
+#include "alloc_tracker.hpp"
+#include "bench_arena.hpp"
+#include "bench_args.hpp"
+#include "bench_dataset.hpp"
+#include "bench_results.hpp"
+#include "bench_rng.hpp"
+#include "checkpoint.hpp"
+#include "primality.hpp"
+#include "segmented_sieve.hpp"
+#include "sort_engine.hpp"
 
-// Global variables for MPI
+// Global variables for MPI. The kernels run on g_comm, which is MPI_COMM_WORLD (or its
+// node-ordered copy with --hierarchical) except while the scaling runs use a subset of the ranks.
+MPI_Comm g_comm = MPI_COMM_WORLD;
 int g_world_size = 1;
 int g_rank = 0;
 
+// Checkpointing of the long prime count (--checkpoint-dir, --resume); off by default
+CheckpointConfig g_checkpoints;
+
+// Per-rank split of a kernel's wall time, for the scaling runs
+struct RankBreakdown {
+    double compute = 0;
+    double comm = 0;
+    double wait = 0;
+};
+
+// Brackets every MPI call in the kernels with MPI_Wtime. Time inside the calls counts as
+// communication and the rest of the kernel as compute. With split_wait, each collective is
+// preceded by a timed barrier and each receive by a timed probe, so the time spent waiting
+// for slower ranks is counted as wait instead of communication.
+class RankTimer {
+public:
+    void start(bool split_wait) {
+        split_wait_ = split_wait;
+        comm_ = wait_ = 0;
+        start_ = MPI_Wtime();
+    }
+    
+    RankBreakdown stop() const {
+        double total = MPI_Wtime() - start_;
+        return {total - comm_ - wait_, comm_, wait_};
+    }
+    
+    // `comm` is the communicator of the wrapped call, which the barrier has to match
+    template <typename Fn>
+    void collective(MPI_Comm comm, Fn&& call) {
+        if (split_wait_) {
+            double t = MPI_Wtime();
+            MPI_Barrier(comm);
+            wait_ += MPI_Wtime() - t;
+        }
+        timed(call);
+    }
+    
+    template <typename Fn>
+    void receive(int source, int tag, Fn&& call) {
+        if (split_wait_) {
+            double t = MPI_Wtime();
+            MPI_Probe(source, tag, g_comm, MPI_STATUS_IGNORE);
+            wait_ += MPI_Wtime() - t;
+        }
+        timed(call);
+    }
+    
+    template <typename Fn>
+    void send(Fn&& call) {
+        timed(call);
+    }
+    
+private:
+    template <typename Fn>
+    void timed(Fn& call) {
+        double t = MPI_Wtime();
+        call();
+        comm_ += MPI_Wtime() - t;
+    }
+    
+    bool split_wait_ = false;
+    double start_ = 0;
+    double comm_ = 0;
+    double wait_ = 0;
+};
+
+RankTimer g_timer;
+
+// Node layout for the two-level collectives. `comm` holds all ranks renumbered so that each
+// node's ranks are consecutive (rank 0 stays rank 0); `node` holds the ranks of this rank's
+// node and `leaders` the first rank of every node (MPI_COMM_NULL on the other ranks).
+struct Topology {
+    MPI_Comm comm = MPI_COMM_NULL;
+    MPI_Comm node = MPI_COMM_NULL;
+    MPI_Comm leaders = MPI_COMM_NULL;
+    int node_rank = 0;
+    std::vector<int> node_first; // first rank in `comm` of each node, then the total
+};
+
+Topology g_topology;
+bool g_hierarchical = false; // route the gathers and broadcasts through g_topology
+
+// Nodes are the shared-memory domains from MPI_Comm_split_type or, with ranks_per_node > 0,
+// blocks of that many consecutive world ranks, to emulate several nodes on one machine
+Topology build_topology(int ranks_per_node) {
+    int world_rank, world_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    MPI_Comm shared;
+    if (ranks_per_node > 0) {
+        MPI_Comm_split(MPI_COMM_WORLD, world_rank / ranks_per_node, world_rank, &shared);
+    } else {
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, world_rank, MPI_INFO_NULL,
+                            &shared);
+    }
+
+    // Order nodes by their lowest world rank, and ranks within a node by world rank
+    int node_id, node_rank;
+    MPI_Allreduce(&world_rank, &node_id, 1, MPI_INT, MPI_MIN, shared);
+    MPI_Comm_rank(shared, &node_rank);
+    MPI_Comm_free(&shared);
+
+    Topology topology;
+    MPI_Comm_split(MPI_COMM_WORLD, 0, node_id * world_size + node_rank, &topology.comm);
+    int rank;
+    MPI_Comm_rank(topology.comm, &rank);
+    MPI_Comm_split(topology.comm, node_id, rank, &topology.node);
+    MPI_Comm_split(topology.comm, node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &topology.leaders);
+    topology.node_rank = node_rank;
+
+    std::vector<int> is_first(world_size);
+    int first = node_rank == 0;
+    MPI_Allgather(&first, 1, MPI_INT, is_first.data(), 1, MPI_INT, topology.comm);
+    for (int r = 0; r < world_size; r++) {
+        if (is_first[r]) topology.node_first.push_back(r);
+    }
+    topology.node_first.push_back(world_size);
+    return topology;
+}
+
+// Whether the kernels on g_comm should use the two-level collectives
+bool use_hierarchy() {
+    return g_hierarchical && g_comm == g_topology.comm;
+}
+
+// Two-level MPI_Gatherv to rank 0: the node leaders gather their node's blocks, then rank 0
+// gathers one block per node. counts and displs need only be valid on rank 0, and must lay
+// the ranks' blocks out back to back in rank order.
+void hierarchical_gatherv(const void* send, int count, MPI_Datatype type, void* recv,
+                          const int* counts, const int* displs) {
+    int element;
+    MPI_Type_size(type, &element);
+    const Topology& t = g_topology;
+    int node_size;
+    MPI_Comm_size(t.node, &node_size);
+    std::vector<int> member_counts(t.node_rank == 0 ? node_size : 0);
+    g_timer.collective(t.node, [&] {
+        MPI_Gather(&count, 1, MPI_INT, member_counts.data(), 1, MPI_INT, 0, t.node);
+    });
+
+    // Rank 0 collects straight into place; the other leaders stage their node's data
+    std::vector<char> staging;
+    char* node_block = static_cast<char*>(recv);
+    if (g_rank == 0) {
+        node_block += static_cast<size_t>(displs[0]) * element;
+        if (count > 0 && node_block != send) {
+            std::memcpy(node_block, send, static_cast<size_t>(count) * element);
+        }
+    } else if (t.node_rank == 0) {
+        staging.resize(static_cast<size_t>(std::accumulate(member_counts.begin(),
+                                                           member_counts.end(), 0)) * element);
+        node_block = staging.data();
+    }
+    std::vector<int> member_displs(member_counts.size());
+    std::exclusive_scan(member_counts.begin(), member_counts.end(), member_displs.begin(), 0);
+    g_timer.collective(t.node, [&] {
+        MPI_Gatherv(g_rank == 0 ? MPI_IN_PLACE : send, count, type, node_block,
+                    member_counts.data(), member_displs.data(), type, 0, t.node);
+    });
+    if (t.leaders == MPI_COMM_NULL) return;
+
+    int nodes = static_cast<int>(t.node_first.size()) - 1;
+    std::vector<int> node_counts(g_rank == 0 ? nodes : 0), node_displs(node_counts.size());
+    for (size_t j = 0; j < node_counts.size(); j++) {
+        node_counts[j] = std::accumulate(counts + t.node_first[j], counts + t.node_first[j + 1], 0);
+        node_displs[j] = displs[t.node_first[j]];
+    }
+    int node_total = static_cast<int>(staging.size() / element);
+    g_timer.collective(t.leaders, [&] {
+        MPI_Gatherv(g_rank == 0 ? MPI_IN_PLACE : staging.data(), node_total, type, recv,
+                    node_counts.data(), node_displs.data(), type, 0, t.leaders);
+    });
+}
+
+// Two-level MPI_Allgatherv: gather within each node, exchange whole nodes between leaders,
+// then broadcast within each node. counts and displs are needed on every rank and must lay
+// the blocks out back to back in rank order.
+void hierarchical_allgatherv(const void* send, int count, MPI_Datatype type, void* recv,
+                             const int* counts, const int* displs) {
+    int element;
+    MPI_Type_size(type, &element);
+    const Topology& t = g_topology;
+    int first = g_rank - t.node_rank;
+    int node_size;
+    MPI_Comm_size(t.node, &node_size);
+    char* base = static_cast<char*>(recv);
+    std::vector<int> member_displs(node_size);
+    for (int m = 0; m < node_size; m++) {
+        member_displs[m] = displs[first + m] - displs[first];
+    }
+    char* node_block = base + static_cast<size_t>(displs[first]) * element;
+    if (t.node_rank == 0 && count > 0) {
+        std::memcpy(node_block, send, static_cast<size_t>(count) * element);
+    }
+    g_timer.collective(t.node, [&] {
+        MPI_Gatherv(t.node_rank == 0 ? MPI_IN_PLACE : send, count, type, node_block,
+                    counts + first, member_displs.data(), type, 0, t.node);
+    });
+
+    if (t.leaders != MPI_COMM_NULL) {
+        int nodes = static_cast<int>(t.node_first.size()) - 1;
+        std::vector<int> node_counts(nodes), node_displs(nodes);
+        for (int j = 0; j < nodes; j++) {
+            node_counts[j] = std::accumulate(counts + t.node_first[j],
+                                             counts + t.node_first[j + 1], 0);
+            node_displs[j] = displs[t.node_first[j]];
+        }
+        g_timer.collective(t.leaders, [&] {
+            MPI_Allgatherv(MPI_IN_PLACE, 0, type, recv, node_counts.data(), node_displs.data(),
+                           type, t.leaders);
+        });
+    }
+    int last = t.node_first.back() - 1;
+    int total = displs[last] + counts[last] - displs[0];
+    g_timer.collective(t.node, [&] {
+        MPI_Bcast(base + static_cast<size_t>(displs[0]) * element, total, type, 0, t.node);
+    });
+}
+
+// Two-level MPI_Bcast from rank 0: first to the node leaders, then within each node
+void hierarchical_bcast(void* buffer, int count, MPI_Datatype type) {
+    const Topology& t = g_topology;
+    if (t.leaders != MPI_COMM_NULL) {
+        g_timer.collective(t.leaders, [&] { MPI_Bcast(buffer, count, type, 0, t.leaders); });
+    }
+    g_timer.collective(t.node, [&] { MPI_Bcast(buffer, count, type, 0, t.node); });
+}
+
 // Fibonacci implementations
 unsigned long long fibonacci_serial(int n) {
     if (n <= 1) return n;
     return fibonacci_serial(n - 1) + fibonacci_serial(n - 2);
 }
 
-unsigned long long fibonacci_dynamic(int n) {
+unsigned long long fibonacci_dynamic(int n, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
     if (n <= 1) return n;
-    std::vector<unsigned long long> fib(n + 1);
+    std::pmr::vector<unsigned long long> fib(n + 1, resource);
     fib[1] = 1;
     for (int i = 2; i <= n; i++) {
         fib[i] = fib[i-1] + fib[i-2];
@@ -37,8 +284,8 @@ std::vector<unsigned long long> fibonacci_chunk(int start, int end) {
     return std::vector<unsigned long long>(fib.begin() + start, fib.begin() + end + 1);
 }
 
-std::vector<unsigned long long> fibonacci_parallel(int n) {
-    std::vector<unsigned long long> result(n);
+std::pmr::vector<unsigned long long> fibonacci_parallel(int n, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    std::pmr::vector<unsigned long long> result(n, resource);
     
     // For small n, let rank 0 do all the work
     if (n < 10) {
@@ -69,16 +316,19 @@ std::vector<unsigned long long> fibonacci_parallel(int n) {
     
     // If start > end, this rank doesn't need to calculate anything
     int local_size = (start <= end) ? (end - start + 1) : 0;
-    std::vector<unsigned long long> local_result;
+    std::pmr::vector<unsigned long long> local_result(resource);
     
     if (local_size > 0) {
         // If rank > 0, we need to receive the previous two values
         if (g_rank > 0) {
-            std::vector<unsigned long long> prev_values(2);
-            MPI_Recv(prev_values.data(), 2, MPI_UNSIGNED_LONG_LONG, g_rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            unsigned long long prev_values[2];
+            g_timer.receive(g_rank - 1, 0, [&] {
+                MPI_Recv(prev_values, 2, MPI_UNSIGNED_LONG_LONG, g_rank - 1, 0, g_comm,
+                         MPI_STATUS_IGNORE);
+            });
             
             // Calculate local chunk with received values
-            std::vector<unsigned long long> fib(end + 1);
+            std::pmr::vector<unsigned long long> fib(end + 1, resource);
             fib[start - 2] = prev_values[0];
             fib[start - 1] = prev_values[1];
             
@@ -91,8 +341,10 @@ std::vector<unsigned long long> fibonacci_parallel(int n) {
             
             // Send last two values to next rank if needed
             if (g_rank < g_world_size - 1) {
-                std::vector<unsigned long long> next_values = {fib[end - 1], fib[end]};
-                MPI_Send(next_values.data(), 2, MPI_UNSIGNED_LONG_LONG, g_rank + 1, 0, MPI_COMM_WORLD);
+                unsigned long long next_values[2] = {fib[end - 1], fib[end]};
+                g_timer.send([&] {
+                    MPI_Send(next_values, 2, MPI_UNSIGNED_LONG_LONG, g_rank + 1, 0, g_comm);
+                });
             }
         } else {
             // Rank 0
@@ -104,14 +356,27 @@ std::vector<unsigned long long> fibonacci_parallel(int n) {
             
             // Send last two values to next rank if needed
             if (g_world_size > 1) {
-                std::vector<unsigned long long> next_values = {result[end - 1], result[end]};
-                MPI_Send(next_values.data(), 2, MPI_UNSIGNED_LONG_LONG, 1, 0, MPI_COMM_WORLD);
+                unsigned long long next_values[2] = {result[end - 1], result[end]};
+                g_timer.send([&] {
+                    MPI_Send(next_values, 2, MPI_UNSIGNED_LONG_LONG, 1, 0, g_comm);
+                });
             }
         }
     }
     
-    // Gather results from all processes
-    if (g_rank == 0) {
+    // Gather results from all processes. The boundary values above only pass between
+    // neighbouring ranks, so with node-contiguous ranks they cross a node boundary once per node.
+    if (use_hierarchy()) {
+        // Rank 0's chunk (with F(0), F(1)) is already in place, the others follow in rank order
+        std::vector<int> chunk_counts(g_world_size), chunk_displs(g_world_size);
+        for (int i = 0; i < g_world_size; i++) {
+            chunk_displs[i] = std::min(i * chunk_size, n);
+            chunk_counts[i] = std::min((i + 1) * chunk_size, n) - chunk_displs[i];
+        }
+        hierarchical_gatherv(g_rank == 0 ? result.data() : local_result.data(),
+                             chunk_counts[g_rank], MPI_UNSIGNED_LONG_LONG, result.data(),
+                             chunk_counts.data(), chunk_displs.data());
+    } else if (g_rank == 0) {
         // Rank 0 already has its portion, receive others
         for (int i = 1; i < g_world_size; i++) {
             int remote_start = i * chunk_size;
@@ -121,34 +386,33 @@ std::vector<unsigned long long> fibonacci_parallel(int n) {
             int remote_end = std::min((i + 1) * chunk_size - 1, n - 1);
             int remote_size = remote_end - remote_start + 1;
             
-            std::vector<unsigned long long> remote_result(remote_size);
-            MPI_Recv(remote_result.data(), remote_size, MPI_UNSIGNED_LONG_LONG, 
-                   i, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            
-            // Copy received chunk to result
-            std::copy(remote_result.begin(), remote_result.end(), result.begin() + remote_start);
+            // Receive straight into place
+            g_timer.receive(i, 1, [&] {
+                MPI_Recv(result.data() + remote_start, remote_size, MPI_UNSIGNED_LONG_LONG,
+                         i, 1, g_comm, MPI_STATUS_IGNORE);
+            });
         }
     } else if (local_size > 0) {
         // Send local results to rank 0
-        MPI_Send(local_result.data(), local_size, MPI_UNSIGNED_LONG_LONG, 0, 1, MPI_COMM_WORLD);
+        g_timer.send([&] {
+            MPI_Send(local_result.data(), local_size, MPI_UNSIGNED_LONG_LONG, 0, 1, g_comm);
+        });
     }
     
     // Make sure all processes have the same result
-    MPI_Bcast(result.data(), n, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (use_hierarchy()) {
+        hierarchical_bcast(result.data(), n, MPI_UNSIGNED_LONG_LONG);
+    } else {
+        g_timer.collective(g_comm, [&] {
+            MPI_Bcast(result.data(), n, MPI_UNSIGNED_LONG_LONG, 0, g_comm);
+        });
+    }
     
     return result;
 }
 
-bool is_prime(int n) {
-    if (n < 2) return false;
-    for (int i = 2; i <= sqrt(n); i++) {
-        if (n % i == 0) return false;
-    }
-    return true;
-}
-
-std::vector<int> find_primes_serial(int limit) {
-    std::vector<int> primes;
+std::pmr::vector<int> find_primes_serial(int limit, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    std::pmr::vector<int> primes(resource);
     for (int n = 2; n <= limit; n++) {
         if (is_prime(n)) {
             primes.push_back(n);
@@ -157,8 +421,8 @@ std::vector<int> find_primes_serial(int limit) {
     return primes;
 }
 
-std::vector<int> find_primes_range(int start, int end) {
-    std::vector<int> local_primes;
+std::pmr::vector<int> find_primes_range(int start, int end, std::pmr::memory_resource* resource) {
+    std::pmr::vector<int> local_primes(resource);
     for (int n = start; n <= end; n++) {
         if (is_prime(n)) {
             local_primes.push_back(n);
@@ -167,22 +431,24 @@ std::vector<int> find_primes_range(int start, int end) {
     return local_primes;
 }
 
-std::vector<int> find_primes_parallel(int limit) {
+std::pmr::vector<int> find_primes_parallel(int limit, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
     // Distribute work among processes
     int chunk_size = (limit - 1) / g_world_size;
     int start = g_rank * chunk_size + 2;
     int end = (g_rank + 1) * chunk_size + 1;
     if (g_rank == g_world_size - 1) end = limit;
     
-    std::vector<int> local_primes = find_primes_range(start, end);
+    std::pmr::vector<int> local_primes = find_primes_range(start, end, resource);
     int local_count = local_primes.size();
     
     // Gather all counts to determine total size and displacements
-    std::vector<int> counts(g_world_size);
-    MPI_Allgather(&local_count, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    std::pmr::vector<int> counts(g_world_size, resource);
+    g_timer.collective(g_comm, [&] {
+        MPI_Allgather(&local_count, 1, MPI_INT, counts.data(), 1, MPI_INT, g_comm);
+    });
     
     // Calculate displacements
-    std::vector<int> displs(g_world_size);
+    std::pmr::vector<int> displs(g_world_size, resource);
     int total_count = 0;
     for (int i = 0; i < g_world_size; i++) {
         displs[i] = total_count;
@@ -190,12 +456,19 @@ std::vector<int> find_primes_parallel(int limit) {
     }
     
     // Allocate space for all primes
-    std::vector<int> all_primes(total_count);
+    std::pmr::vector<int> all_primes(total_count, resource);
     
     // Gather all primes with variable counts
-    MPI_Allgatherv(local_primes.data(), local_count, MPI_INT, 
-                  all_primes.data(), counts.data(), displs.data(), 
-                  MPI_INT, MPI_COMM_WORLD);
+    if (use_hierarchy()) {
+        hierarchical_allgatherv(local_primes.data(), local_count, MPI_INT, all_primes.data(),
+                                counts.data(), displs.data());
+    } else {
+        g_timer.collective(g_comm, [&] {
+            MPI_Allgatherv(local_primes.data(), local_count, MPI_INT,
+                           all_primes.data(), counts.data(), displs.data(),
+                           MPI_INT, g_comm);
+        });
+    }
     
     // Sort the result (already sorted by process rank, but need to merge)
     std::sort(all_primes.begin(), all_primes.end());
@@ -203,81 +476,571 @@ std::vector<int> find_primes_parallel(int limit) {
     return all_primes;
 }
 
-void quicksort_serial(std::vector<int>& arr, int low, int high) {
-    if (low < high) {
-        int pivot = arr[high];
-        int i = low - 1;
-        
-        for (int j = low; j < high; j++) {
-            if (arr[j] <= pivot) {
-                i++;
-                std::swap(arr[i], arr[j]);
-            }
-        }
-        std::swap(arr[i + 1], arr[high]);
-        
-        int pi = i + 1;
-        quicksort_serial(arr, low, pi - 1);
-        quicksort_serial(arr, pi + 1, high);
+// Base primes up to sqrt(limit), computed once on rank 0 and broadcast to every rank
+std::vector<uint32_t> broadcast_base_primes(uint64_t limit) {
+    std::vector<uint32_t> primes;
+    uint64_t count = 0;
+    if (g_rank == 0) {
+        primes = base_primes(static_cast<uint32_t>(isqrt(limit)));
+        count = primes.size();
     }
+    if (use_hierarchy()) {
+        hierarchical_bcast(&count, 1, MPI_UINT64_T);
+        primes.resize(count);
+        hierarchical_bcast(primes.data(), static_cast<int>(count), MPI_UINT32_T);
+        return primes;
+    }
+    g_timer.collective(g_comm, [&] { MPI_Bcast(&count, 1, MPI_UINT64_T, 0, g_comm); });
+    primes.resize(count);
+    g_timer.collective(g_comm, [&] {
+        MPI_Bcast(primes.data(), static_cast<int>(count), MPI_UINT32_T, 0, g_comm);
+    });
+    return primes;
 }
 
-void quicksort_parallel(std::vector<int>& arr) {
-    if (arr.size() <= 1) {
-        return;
+// This rank's share [lo, hi) of the numbers 0 .. limit
+void sieve_share(uint64_t limit, uint64_t& lo, uint64_t& hi) {
+    uint64_t total = limit + 1;
+    uint64_t base = total / g_world_size;
+    uint64_t remainder = total % g_world_size;
+    lo = g_rank * base + std::min<uint64_t>(g_rank, remainder);
+    hi = lo + base + (static_cast<uint64_t>(g_rank) < remainder ? 1 : 0);
+}
+
+// Number of primes <= limit by segmented sieve: each rank sieves its share in blocks of
+// `block_bytes` and the counts are summed with MPI_Reduce (the result is valid on rank 0).
+// If `checkpointed` and checkpointing is on, every rank checkpoints its own share to its own
+// file, so a resumed run only sieves the slices each rank had not finished.
+uint64_t count_primes_sieve(uint64_t limit, size_t block_bytes, bool checkpointed = false) {
+    std::vector<uint32_t> primes = broadcast_base_primes(limit);
+    uint64_t lo, hi;
+    sieve_share(limit, lo, hi);
+    uint64_t local_count;
+    if (checkpointed && !g_checkpoints.dir.empty()) {
+        Checkpoint checkpoint = g_checkpoints.open(
+            "prime_count.rank" + std::to_string(g_rank),
+            checkpoint_fingerprint({limit, lo, hi, block_bytes}));
+        local_count = count_primes_checkpointed(lo, hi, primes, 1, checkpoint, block_bytes);
+    } else {
+        local_count = count_primes(lo, hi, primes, block_bytes);
+    }
+    
+    uint64_t total_count = 0;
+    g_timer.collective(g_comm, [&] {
+        MPI_Reduce(&local_count, &total_count, 1, MPI_UINT64_T, MPI_SUM, 0, g_comm);
+    });
+    return total_count;
+}
+
+// Primes <= limit by segmented sieve, gathered in order on rank 0 (other ranks get an
+// empty vector)
+std::pmr::vector<int> find_primes_sieve(int limit, size_t block_bytes, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    std::vector<uint32_t> primes = broadcast_base_primes(std::max(limit, 0));
+    uint64_t lo, hi;
+    sieve_share(std::max(limit, 0), lo, hi);
+    std::pmr::vector<int> local_primes(resource);
+    for_each_prime(lo, hi, primes, [&](uint64_t p) { local_primes.push_back(static_cast<int>(p)); },
+                   block_bytes);
+    int local_count = local_primes.size();
+    
+    std::pmr::vector<int> counts(g_rank == 0 ? g_world_size : 0, resource);
+    g_timer.collective(g_comm, [&] {
+        MPI_Gather(&local_count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, g_comm);
+    });
+    
+    std::pmr::vector<int> displs(counts.size(), resource);
+    std::pmr::vector<int> all_primes(resource);
+    if (g_rank == 0) {
+        std::exclusive_scan(counts.begin(), counts.end(), displs.begin(), 0);
+        all_primes.resize(displs.back() + counts.back());
     }
     
-    // Distribute the array across processes
-    int size = arr.size();
+    // Shares are in ascending order, so the gathered primes are already sorted
+    if (use_hierarchy()) {
+        hierarchical_gatherv(local_primes.data(), local_count, MPI_INT, all_primes.data(),
+                             counts.data(), displs.data());
+    } else {
+        g_timer.collective(g_comm, [&] {
+            MPI_Gatherv(local_primes.data(), local_count, MPI_INT, all_primes.data(),
+                        counts.data(), displs.data(), MPI_INT, 0, g_comm);
+        });
+    }
+    return all_primes;
+}
+
+// Block distribution of `size` elements over all ranks (first `remainder` ranks get one extra)
+void block_partition(int size, std::pmr::vector<int>& counts, std::pmr::vector<int>& displs) {
     int local_size = size / g_world_size;
     int remainder = size % g_world_size;
     
-    // Calculate local sizes and displacements considering remainder
-    std::vector<int> sendcounts(g_world_size);
-    std::vector<int> displs(g_world_size);
-    
+    counts.assign(g_world_size, local_size);
+    displs.assign(g_world_size, 0);
     for (int i = 0; i < g_world_size; i++) {
-        sendcounts[i] = local_size;
         if (i < remainder) {
-            sendcounts[i]++;
+            counts[i]++;
         }
-        displs[i] = (i > 0) ? displs[i-1] + sendcounts[i-1] : 0;
+        displs[i] = (i > 0) ? displs[i-1] + counts[i-1] : 0;
+    }
+}
+
+// Sorts a block-distributed array. Each rank passes the slice it owns (see block_partition)
+// in local_arr; the sorted result is assembled in arr on rank 0.
+void quicksort_parallel(std::vector<int>& local_arr, std::vector<int>& arr, int size,
+                        std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    if (size <= 1) {
+        if (g_rank == 0) arr = local_arr;
+        return;
     }
     
-    // Allocate space for local array
-    std::vector<int> local_arr(sendcounts[g_rank]);
-    
-    // Scatter the array from root to all processes
-    MPI_Scatterv(arr.data(), sendcounts.data(), displs.data(), MPI_INT,
-                local_arr.data(), sendcounts[g_rank], MPI_INT,
-                0, MPI_COMM_WORLD);
+    std::pmr::vector<int> counts(resource);
+    std::pmr::vector<int> displs(resource);
+    block_partition(size, counts, displs);
     
     // Sort local portion
-    quicksort_serial(local_arr, 0, local_arr.size() - 1);
+    quicksort_serial(local_arr.begin(), local_arr.end());
     
     // Gather the sorted local arrays back to root
-    MPI_Gatherv(local_arr.data(), sendcounts[g_rank], MPI_INT, 
-               arr.data(), sendcounts.data(), displs.data(), MPI_INT,
-               0, MPI_COMM_WORLD);
+    if (g_rank == 0) arr.resize(size);
+    if (use_hierarchy()) {
+        hierarchical_gatherv(local_arr.data(), counts[g_rank], MPI_INT, arr.data(),
+                             counts.data(), displs.data());
+    } else {
+        g_timer.collective(g_comm, [&] {
+            MPI_Gatherv(local_arr.data(), counts[g_rank], MPI_INT,
+                        arr.data(), counts.data(), displs.data(), MPI_INT,
+                        0, g_comm);
+        });
+    }
     
-    // Root process performs the final merge
+    // Root process performs the final merge as a pairwise merge tree: each pass merges
+    // neighbouring runs, halving their number, so every element moves log2(P) times instead of
+    // once per rank. The passes alternate between arr and one scratch buffer.
     if (g_rank == 0) {
-        // Merge step using a temporary array
-        std::vector<int> temp(size);
-        for (int i = 0; i < g_world_size - 1; i++) {
-            int left_start = displs[i];
-            int mid = displs[i+1] - 1;
-            int right_end = (i + 2 < g_world_size) ? displs[i+2] - 1 : size - 1;
-            
-            // Create temporary arrays for the two halves
-            std::vector<int> left(arr.begin() + left_start, arr.begin() + mid + 1);
-            std::vector<int> right(arr.begin() + mid + 1, arr.begin() + right_end + 1);
-            
-            // Merge the two sorted arrays
-            std::merge(left.begin(), left.end(), right.begin(), right.end(), 
-                      arr.begin() + left_start);
+        std::pmr::vector<int> bounds(displs.begin(), displs.end(), resource);
+        bounds.push_back(size);
+        std::pmr::vector<int> next(resource);
+        std::pmr::vector<int> merged(size, resource);
+        int* src = arr.data();
+        int* dst = merged.data();
+        while (bounds.size() > 2) {
+            next.clear();
+            size_t i = 0;
+            for (; i + 2 < bounds.size(); i += 2) {
+                std::merge(src + bounds[i], src + bounds[i+1], src + bounds[i+1],
+                           src + bounds[i+2], dst + bounds[i]);
+                next.push_back(bounds[i]);
+            }
+            // An odd run out is carried over to the next pass unchanged
+            if (i + 1 < bounds.size()) {
+                std::copy(src + bounds[i], src + bounds[i+1], dst + bounds[i]);
+                next.push_back(bounds[i]);
+            }
+            next.push_back(size);
+            bounds.swap(next);
+            std::swap(src, dst);
+        }
+        if (src != arr.data()) std::copy(src, src + size, arr.data());
+    }
+}
+
+// Sample sort across all ranks: on return every rank holds a sorted slice and the slices
+// are globally ordered by rank, so no rank ever needs the whole array
+void samplesort_distributed(std::vector<int>& local_arr) {
+    quicksort_serial(local_arr.begin(), local_arr.end());
+    if (g_world_size == 1) return;
+    
+    // Regular samples from every rank select world_size - 1 splitters
+    std::vector<int> samples(g_world_size - 1, 0);
+    for (int i = 0; i < g_world_size - 1 && !local_arr.empty(); i++) {
+        samples[i] = local_arr[(i + 1) * local_arr.size() / g_world_size];
+    }
+    std::vector<int> all_samples(g_world_size * (g_world_size - 1));
+    g_timer.collective(g_comm, [&] {
+        MPI_Allgather(samples.data(), g_world_size - 1, MPI_INT,
+                      all_samples.data(), g_world_size - 1, MPI_INT, g_comm);
+    });
+    std::sort(all_samples.begin(), all_samples.end());
+    
+    // Bucket boundaries in the sorted local slice; the Alltoallv counts and displacements are
+    // ints, so a slice past INT_MAX keys cannot be exchanged
+    if (local_arr.size() > static_cast<size_t>(INT_MAX)) {
+        std::cerr << "Rank " << g_rank << ": " << local_arr.size()
+                  << " keys do not fit an MPI_Alltoallv count" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    std::vector<int> send_counts(g_world_size);
+    std::vector<int> send_displs(g_world_size);
+    auto bucket_start = local_arr.begin();
+    for (int i = 0; i < g_world_size; i++) {
+        auto bucket_end = local_arr.end();
+        if (i < g_world_size - 1) {
+            int splitter = all_samples[(i + 1) * (g_world_size - 1)];
+            bucket_end = std::upper_bound(bucket_start, local_arr.end(), splitter);
+        }
+        send_displs[i] = bucket_start - local_arr.begin();
+        send_counts[i] = bucket_end - bucket_start;
+        bucket_start = bucket_end;
+    }
+    
+    std::vector<int> recv_counts(g_world_size);
+    std::vector<int> recv_displs(g_world_size);
+    g_timer.collective(g_comm, [&] {
+        MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, g_comm);
+    });
+    int64_t recv_total = 0;
+    for (int i = 0; i < g_world_size; i++) {
+        recv_displs[i] = static_cast<int>(recv_total);
+        recv_total += recv_counts[i];
+    }
+    if (recv_total > INT_MAX) {
+        std::cerr << "Rank " << g_rank << ": " << recv_total
+                  << " received keys do not fit an MPI_Alltoallv displacement" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    
+    std::vector<int> received(recv_total);
+    g_timer.collective(g_comm, [&] {
+        MPI_Alltoallv(local_arr.data(), send_counts.data(), send_displs.data(), MPI_INT,
+                      received.data(), recv_counts.data(), recv_displs.data(), MPI_INT,
+                      g_comm);
+    });
+    
+    // Each incoming bucket is already sorted; fold them into one run
+    for (int i = 1; i < g_world_size; i++) {
+        std::inplace_merge(received.begin(), received.begin() + recv_displs[i],
+                           received.begin() + recv_displs[i] + recv_counts[i]);
+    }
+    local_arr.swap(received);
+}
+
+// This rank's [offset, offset + count) block of `total` elements
+void block_range(MPI_Offset total, MPI_Offset& offset, MPI_Offset& count) {
+    MPI_Offset base = total / g_world_size;
+    MPI_Offset remainder = total % g_world_size;
+    count = base + (g_rank < remainder ? 1 : 0);
+    offset = g_rank * base + std::min<MPI_Offset>(g_rank, remainder);
+}
+
+// The MPI-IO element counts are ints, so a slice past INT_MAX keys is moved in chunks. The
+// calls are collective: every rank makes as many as the rank with the most chunks, passing 0
+// once it is done.
+constexpr MPI_Offset kMaxIoChunk = INT_MAX;
+
+int collective_io_chunks(MPI_Offset count) {
+    MPI_Offset chunks = (count + kMaxIoChunk - 1) / kMaxIoChunk;
+    MPI_Offset max_chunks = 0;
+    MPI_Allreduce(&chunks, &max_chunks, 1, MPI_OFFSET, MPI_MAX, g_comm);
+    return static_cast<int>(max_chunks);
+}
+
+void read_ints_at_all(MPI_File file, MPI_Offset byte_offset, int* data, MPI_Offset count) {
+    int chunks = collective_io_chunks(count);
+    for (int c = 0; c < chunks; c++) {
+        MPI_Offset first = std::min(count, c * kMaxIoChunk);
+        int n = static_cast<int>(std::min(kMaxIoChunk, count - first));
+        MPI_File_read_at_all(file, byte_offset + first * sizeof(int), data + first, n, MPI_INT,
+                             MPI_STATUS_IGNORE);
+    }
+}
+
+void write_ints_at_all(MPI_File file, MPI_Offset byte_offset, const int* data,
+                       MPI_Offset count) {
+    int chunks = collective_io_chunks(count);
+    for (int c = 0; c < chunks; c++) {
+        MPI_Offset first = std::min(count, c * kMaxIoChunk);
+        int n = static_cast<int>(std::min(kMaxIoChunk, count - first));
+        MPI_File_write_at_all(file, byte_offset + first * sizeof(int), data + first, n, MPI_INT,
+                              MPI_STATUS_IGNORE);
+    }
+}
+
+// Collectively writes `total` generated int keys to `path`, each rank its own block
+void generate_mpi_io_input(const std::string& path, MPI_Offset total, const CounterRng& rng) {
+    MPI_Offset offset, count;
+    block_range(total, offset, count);
+    std::vector<int> local_arr(count);
+    fill_uniform_int(local_arr.data(), count, offset, rng, 1, 1000000, 1);
+    
+    MPI_File file;
+    MPI_File_open(g_comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                  MPI_INFO_NULL, &file);
+    MPI_File_set_size(file, total * sizeof(int));
+    write_ints_at_all(file, offset * sizeof(int), local_arr.data(), count);
+    MPI_File_close(&file);
+}
+
+// Collectively saves the sort input as a dataset file: every rank writes its slice of the
+// payload, then rank 0 writes the header with the summed slice checksums, so the file only
+// becomes a valid dataset once all of it is on disk
+void save_mpi_dataset(const std::string& path, const std::vector<int>& local_arr,
+                      MPI_Offset total, MPI_Offset offset, uint64_t seed) {
+    uint64_t local_checksum = dataset_checksum(local_arr.data(), local_arr.size());
+    uint64_t checksum = 0;
+    MPI_Reduce(&local_checksum, &checksum, 1, MPI_UINT64_T, MPI_SUM, 0, g_comm);
+    
+    MPI_File file;
+    MPI_File_open(g_comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                  MPI_INFO_NULL, &file);
+    MPI_File_set_size(file, sizeof(DatasetHeader) + total * sizeof(int));
+    write_ints_at_all(file, sizeof(DatasetHeader) + offset * sizeof(int), local_arr.data(),
+                      local_arr.size());
+    MPI_File_sync(file);
+    MPI_Barrier(g_comm);
+    if (g_rank == 0) {
+        DatasetHeader header{kDatasetMagic, kDatasetVersion, DatasetType::Int32,
+                             static_cast<uint64_t>(total), seed, checksum, 1, {}};
+        MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&file);
+}
+
+// Sorts a file of int keys that never has to fit on one node: every rank reads its block with
+// MPI_File_read_at_all, the ranks sample sort, and each rank writes its globally ordered slice
+// at the offset given by the prefix sum of the slice sizes with MPI_File_write_at_all
+bool run_mpi_io_sort(const std::string& input, const std::string& output, ResultList& results) {
+    MPI_File file;
+    if (MPI_File_open(g_comm, input.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) !=
+        MPI_SUCCESS) {
+        if (g_rank == 0) std::cerr << "Cannot open MPI-IO input " << input << std::endl;
+        return false;
+    }
+    
+    MPI_Barrier(g_comm);
+    double start_time = MPI_Wtime();
+    
+    MPI_Offset file_size, offset, count;
+    MPI_File_get_size(file, &file_size);
+    MPI_Offset total = file_size / sizeof(int);
+    block_range(total, offset, count);
+    std::vector<int> local_arr(count);
+    read_ints_at_all(file, offset * sizeof(int), local_arr.data(), count);
+    MPI_File_close(&file);
+    double read_done = MPI_Wtime();
+    
+    samplesort_distributed(local_arr);
+    double sort_done = MPI_Wtime();
+    
+    MPI_Offset local_count = local_arr.size();
+    MPI_Offset write_offset = 0;
+    MPI_Exscan(&local_count, &write_offset, 1, MPI_OFFSET, MPI_SUM, g_comm);
+    if (g_rank == 0) write_offset = 0;
+    
+    MPI_File_open(g_comm, output.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                  MPI_INFO_NULL, &file);
+    MPI_File_set_size(file, total * sizeof(int));
+    write_ints_at_all(file, write_offset * sizeof(int), local_arr.data(), local_count);
+    MPI_File_close(&file);
+    double write_done = MPI_Wtime();
+    
+    // Report the slowest rank for each phase
+    double local_times[3] = {read_done - start_time, sort_done - read_done, write_done - sort_done};
+    double max_times[3];
+    MPI_Reduce(local_times, max_times, 3, MPI_DOUBLE, MPI_MAX, 0, g_comm);
+    
+    if (g_rank == 0) {
+        double total_time = write_done - start_time;
+        std::cout << "MPI-IO Sort Time: " << total_time << " seconds (read " << max_times[0]
+                  << " s, sort " << max_times[1] << " s, write " << max_times[2] << " s, "
+                  << total << " keys)" << std::endl;
+        results.emplace_back("mpi_io_sort", total_time);
+        results.emplace_back("mpi_io_read", max_times[0]);
+        results.emplace_back("mpi_io_sort_compute", max_times[1]);
+        results.emplace_back("mpi_io_write", max_times[2]);
+        results.emplace_back("mpi_io_keys", total);
+    }
+    return true;
+}
+
+// Scaling runs: each kernel on the first p ranks for p = 1, 2, 4, ... up to the world size,
+// with a fixed global problem (strong scaling) or one that grows with p (weak scaling, the
+// sizes are then per rank). Each rank's compute, communication and wait times (RankTimer) are
+// gathered on rank 0 and appended as "scaling_<mode>_<kernel>_p<p>_*": the wall time (the
+// slowest rank), the efficiency relative to p = 1, min/max/avg of each time and the
+// imbalance, max/avg of the compute time.
+void run_scaling(bool weak, int fib_n, uint64_t prime_limit, int sort_size, uint64_t seed,
+                 ResultList& results) {
+    std::vector<int> rank_counts;
+    for (int p = 1; p < g_world_size; p *= 2) rank_counts.push_back(p);
+    rank_counts.push_back(g_world_size);
+    
+    const char* mode = weak ? "weak" : "strong";
+    const char* kernels[] = {"fibonacci", "prime_count", "sort"};
+    double base_time[3] = {0, 0, 0};
+    int world_size = g_world_size;
+    MPI_Comm world = g_comm;
+    for (int p : rank_counts) {
+        // All ranks, those left out at this p too, switch to a phase of their own for the
+        // split and the closing barrier, so neither is charged to an earlier kernel's phase
+        std::string phase = std::string("scaling_") + mode + "_p" + std::to_string(p);
+        MPI_Pcontrol(1, phase.c_str());
+        MPI_Comm sub;
+        MPI_Comm_split(world, g_rank < p ? 0 : MPI_UNDEFINED, g_rank, &sub);
+        if (sub != MPI_COMM_NULL) {
+            g_comm = sub;
+            g_world_size = p;
+            int scale = weak ? p : 1;
+            for (int k = 0; k < 3; k++) {
+                // The sort input is generated before the timed part
+                std::pmr::vector<int> counts, displs;
+                std::vector<int> local_array, sorted_array;
+                if (k == 2) {
+                    block_partition(sort_size * scale, counts, displs);
+                    local_array.resize(counts[g_rank]);
+                    fill_uniform_int(local_array.data(), counts[g_rank], displs[g_rank],
+                                     CounterRng(seed), 1, 1000000, 1);
+                }
+                
+                std::string prefix = std::string("scaling_") + mode + "_" + kernels[k] + "_p" +
+                                     std::to_string(p);
+                MPI_Pcontrol(1, prefix.c_str());
+                MPI_Barrier(g_comm);
+                g_timer.start(true);
+                if (k == 0) {
+                    fibonacci_parallel(fib_n * scale);
+                } else if (k == 1) {
+                    count_primes_sieve(prime_limit * scale, kSieveBlockBytes);
+                } else {
+                    quicksort_parallel(local_array, sorted_array, sort_size * scale);
+                }
+                RankBreakdown breakdown = g_timer.stop();
+                
+                std::vector<RankBreakdown> all(g_rank == 0 ? p : 0);
+                MPI_Gather(&breakdown, 3, MPI_DOUBLE, all.data(), 3, MPI_DOUBLE, 0, g_comm);
+                if (g_rank != 0) continue;
+                
+                auto stats = [&all](double RankBreakdown::*field) {
+                    double lo = all[0].*field, hi = lo, sum = 0;
+                    for (const RankBreakdown& b : all) {
+                        lo = std::min(lo, b.*field);
+                        hi = std::max(hi, b.*field);
+                        sum += b.*field;
+                    }
+                    return std::array<double, 3>{lo, hi, sum / all.size()};
+                };
+                double wall = 0;
+                for (const RankBreakdown& b : all) {
+                    wall = std::max(wall, b.compute + b.comm + b.wait);
+                }
+                if (p == 1) base_time[k] = wall;
+                double efficiency = weak ? base_time[k] / wall : base_time[k] / (p * wall);
+                auto compute = stats(&RankBreakdown::compute);
+                auto comm = stats(&RankBreakdown::comm);
+                auto wait = stats(&RankBreakdown::wait);
+                double imbalance = compute[2] > 0 ? compute[1] / compute[2] : 1;
+                
+                std::cout << mode << " " << kernels[k] << " p=" << p << ": " << wall
+                          << " seconds, efficiency " << efficiency << ", compute "
+                          << compute[0] << "/" << compute[1] << "/" << compute[2] << ", comm "
+                          << comm[0] << "/" << comm[1] << "/" << comm[2] << ", wait "
+                          << wait[0] << "/" << wait[1] << "/" << wait[2] << " (min/max/avg),"
+                          << " imbalance " << imbalance << std::endl;
+                results.emplace_back(prefix + "_time", wall);
+                results.emplace_back(prefix + "_efficiency", efficiency);
+                const char* suffixes[] = {"_min", "_max", "_avg"};
+                for (int i = 0; i < 3; i++) {
+                    results.emplace_back(prefix + "_compute" + suffixes[i], compute[i]);
+                    results.emplace_back(prefix + "_comm" + suffixes[i], comm[i]);
+                    results.emplace_back(prefix + "_wait" + suffixes[i], wait[i]);
+                }
+                results.emplace_back(prefix + "_imbalance", imbalance);
+            }
+            MPI_Pcontrol(1, phase.c_str());
+            MPI_Comm_free(&sub);
+            g_comm = world;
+            g_world_size = world_size;
+        }
+        MPI_Barrier(world);
+    }
+    // The kernels after the sweep run their collectives without the wait barriers again
+    g_timer.start(false);
+}
+
+// Flat vs two-level collectives: each kernel runs `reps` times on the node-ordered
+// communicator with plain MPI collectives and with the hierarchical ones, and the best time of
+// the slowest rank is appended as "topology_<kernel>_flat" and "topology_<kernel>_hierarchical".
+// Rank 0 checks that both produce the same result.
+void run_topology(int fib_n, int prime_limit, int sort_size, uint64_t seed, int reps,
+                  size_t sieve_block, ResultList& results) {
+    MPI_Comm comm = g_comm;
+    int rank = g_rank;
+    bool hierarchical = g_hierarchical;
+    g_comm = g_topology.comm;
+    MPI_Comm_rank(g_comm, &g_rank);
+    
+    int nodes = static_cast<int>(g_topology.node_first.size()) - 1;
+    int node_size;
+    MPI_Comm_size(g_topology.node, &node_size);
+    int largest_node;
+    MPI_Reduce(&node_size, &largest_node, 1, MPI_INT, MPI_MAX, 0, g_comm);
+    if (g_rank == 0) {
+        std::cout << nodes << " node(s), up to " << largest_node << " ranks per node"
+                  << std::endl;
+        results.emplace_back("topology_nodes", nodes);
+        results.emplace_back("topology_ranks_per_node", largest_node);
+    }
+    
+    std::pmr::vector<int> counts, displs;
+    block_partition(sort_size, counts, displs);
+    const char* kernels[] = {"fibonacci", "primes_parallel", "primes_sieve", "sort"};
+    for (int k = 0; k < 4; k++) {
+        double best[2];
+        std::vector<long long> output[2];
+        for (int mode = 0; mode < 2; mode++) {
+            g_hierarchical = mode == 1;
+            best[mode] = 0;
+            for (int rep = 0; rep < reps; rep++) {
+                // The sort input is regenerated outside the timed part
+                std::vector<int> local_array, sorted_array;
+                if (k == 3) {
+                    local_array.resize(counts[g_rank]);
+                    fill_uniform_int(local_array.data(), counts[g_rank], displs[g_rank],
+                                     CounterRng(seed), 1, 1000000, 1);
+                }
+                
+                MPI_Barrier(g_comm);
+                double start = MPI_Wtime();
+                std::vector<long long> values;
+                if (k == 0) {
+                    auto fib = fibonacci_parallel(fib_n);
+                    values.assign(fib.begin(), fib.end());
+                } else if (k == 1) {
+                    auto primes = find_primes_parallel(prime_limit);
+                    values.assign(primes.begin(), primes.end());
+                } else if (k == 2) {
+                    auto primes = find_primes_sieve(prime_limit, sieve_block);
+                    values.assign(primes.begin(), primes.end());
+                } else {
+                    quicksort_parallel(local_array, sorted_array, sort_size);
+                    values.assign(sorted_array.begin(), sorted_array.end());
+                }
+                double elapsed = MPI_Wtime() - start, slowest;
+                MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, g_comm);
+                if (rep == 0 || slowest < best[mode]) best[mode] = slowest;
+                if (rep == 0) output[mode] = std::move(values);
+            }
         }
+        if (g_rank != 0) continue;
+        
+        std::cout << kernels[k] << ": flat " << best[0] << " seconds, hierarchical " << best[1]
+                  << " seconds (" << best[0] / best[1] << "x)" << std::endl;
+        if (output[0] != output[1]) {
+            std::cerr << "Hierarchical " << kernels[k] << " result differs from the flat one"
+                      << std::endl;
+        }
+        std::string prefix = std::string("topology_") + kernels[k];
+        results.emplace_back(prefix + "_flat", best[0]);
+        results.emplace_back(prefix + "_hierarchical", best[1]);
     }
+    
+    g_comm = comm;
+    g_rank = rank;
+    g_hierarchical = hierarchical;
+}
+
+// Starts allocation accounting for one kernel, first reclaiming the arena if one is in use
+AllocScope begin_kernel(KernelArena* arena) {
+    if (arena) arena->reset();
+    return AllocScope();
 }
 
 int main(int argc, char* argv[]) {
@@ -290,10 +1053,78 @@ int main(int argc, char* argv[]) {
         std::cout << "Running with " << g_world_size << " MPI processes" << std::endl;
     }
     
+    // --checkpoint-dir DIR saves each rank's progress in the prime count every
+    // --checkpoint-interval seconds; --resume continues from those files
+    g_checkpoints.resume = has_flag(argc, argv, "--resume");
+    g_checkpoints.dir = get_option(argc, argv, "--checkpoint-dir",
+                                   g_checkpoints.resume ? "checkpoints" : "");
+    g_checkpoints.interval_seconds = std::stod(get_option(argc, argv, "--checkpoint-interval", "60"));
+    // Every rank creates the directory, since ranks on other nodes may not share rank 0's
+    // file system
+    if (!g_checkpoints.dir.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(g_checkpoints.dir, error);
+        if (!std::filesystem::is_directory(g_checkpoints.dir, error)) {
+            std::cerr << "Rank " << g_rank << ": cannot create checkpoint directory "
+                      << g_checkpoints.dir << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    
+    // Nodes are found with MPI_Comm_split_type, or emulated with --ranks-per-node K (world
+    // ranks 0..K-1 form node 0, and so on). --hierarchical runs the kernels on node-ordered
+    // ranks with two-level gathers and broadcasts.
+    g_topology = build_topology(std::stoi(get_option(argc, argv, "--ranks-per-node", "0")));
+    if (has_flag(argc, argv, "--hierarchical")) {
+        g_hierarchical = true;
+        g_comm = g_topology.comm;
+        MPI_Comm_rank(g_comm, &g_rank);
+    }
+    
+    // --dataset PATH sorts a saved input (bench_dataset.hpp) that every rank maps, taking its
+    // size and seed from it; if rank 0 does not find PATH, the generated input is saved there
+    std::string dataset_path = get_option(argc, argv, "--dataset");
+    int dataset_found = g_rank == 0 && !dataset_path.empty() &&
+                        std::filesystem::exists(dataset_path);
+    MPI_Bcast(&dataset_found, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::optional<MappedDataset<int32_t>> dataset;
+    if (dataset_found) {
+        try {
+            dataset.emplace(dataset_path);
+        } catch (const std::exception& e) {
+            std::cerr << "Rank " << g_rank << ": " << e.what() << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        // Counts and displacements are int, so larger inputs cannot be scattered
+        if (dataset->size() > static_cast<size_t>(INT_MAX)) {
+            std::cerr << "Rank " << g_rank << ": " << dataset_path << ": " << dataset->size()
+                      << " keys exceed the sort size limit of " << INT_MAX << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    
     const int PRIME_LIMIT = 100000;
-    const int SORT_SIZE = 1000000;
+    const int SORT_SIZE = dataset ? static_cast<int>(dataset->size())
+                                  : std::stoi(get_option(argc, argv, "--sort-size", "1000000"));
     const int FIB_N = 100000;
     
+    // Rank 0 picks the seed (or takes --seed) so every rank generates the same dataset
+    std::string seed_arg = get_option(argc, argv, "--seed");
+    uint64_t seed = dataset ? dataset->seed()
+                  : seed_arg.empty() ? random_seed() : std::stoull(seed_arg);
+    MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    
+    // With --arena the kernels allocate from a preallocated per-rank arena instead of the heap
+    KernelArena* arena = nullptr;
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+    if (has_flag(argc, argv, "--arena")) {
+        arena = &thread_arena(std::stoull(get_option(argc, argv, "--arena-mb", "64")) << 20);
+        resource = arena;
+    }
+    
+    // Allocation counts are reported for rank 0's share of each kernel
+    ResultList extra_results;
+    
     if (g_rank == 0) {
         // Create logs directory if it doesn't exist
         std::filesystem::create_directory("logs");
@@ -306,104 +1137,253 @@ int main(int argc, char* argv[]) {
     double serial_time_primes = 0, parallel_time_primes = 0;
     double serial_time_sort = 0, parallel_time_sort = 0;
     
-    // Fibonacci test
+    // Fibonacci test. MPI_Pcontrol names the phase for the profiling layer (mpi_profile.cpp)
+    // and does nothing without it.
+    MPI_Pcontrol(1, "fibonacci");
     if (g_rank == 0) {
         std::cout << "\nC++ MPI Fibonacci Test" << std::endl;
         
         // Serial implementation (only rank 0)
+        AllocScope alloc = begin_kernel(arena);
         auto start = std::chrono::high_resolution_clock::now();
-        auto fib_serial = fibonacci_dynamic(FIB_N);
+        auto fib_serial = fibonacci_dynamic(FIB_N, resource);
         auto end = std::chrono::high_resolution_clock::now();
         serial_time_fib = std::chrono::duration<double>(end - start).count();
-        std::cout << "Serial Time (Dynamic): " << serial_time_fib << " seconds" << std::endl;
+        std::cout << "Serial Time (Dynamic): " << serial_time_fib << " seconds (" << alloc
+                  << ")" << std::endl;
+        record_allocations(extra_results, "fibonacci_serial", alloc);
     }
     
-    // Parallel implementation (all ranks)
+    // Parallel implementation (all ranks). Like the serial one, each kernel's result lives in a
+    // block of its own: the next begin_kernel() reclaims the --arena memory it points into.
+    AllocScope alloc = begin_kernel(arena);
     MPI_Barrier(MPI_COMM_WORLD);
     double start_time = MPI_Wtime();
-    
-    auto fib_parallel = fibonacci_parallel(FIB_N);
-    
-    double end_time = MPI_Wtime();
+    double end_time;
+    {
+        auto fib_parallel = fibonacci_parallel(FIB_N, resource);
+        end_time = MPI_Wtime();
+    }
     if (g_rank == 0) {
         parallel_time_fib = end_time - start_time;
-        std::cout << "Parallel Time: " << parallel_time_fib << " seconds" << std::endl;
+        std::cout << "Parallel Time: " << parallel_time_fib << " seconds (" << alloc << ")"
+                  << std::endl;
+        record_allocations(extra_results, "fibonacci_parallel", alloc);
     }
     
     // Prime numbers test
+    MPI_Pcontrol(1, "primes");
     if (g_rank == 0) {
         std::cout << "\nC++ MPI Prime Numbers Test" << std::endl;
         
         // Serial implementation (only rank 0)
+        alloc = begin_kernel(arena);
         auto start = std::chrono::high_resolution_clock::now();
-        auto primes_serial = find_primes_serial(PRIME_LIMIT);
+        auto primes_serial = find_primes_serial(PRIME_LIMIT, resource);
         auto end = std::chrono::high_resolution_clock::now();
         serial_time_primes = std::chrono::duration<double>(end - start).count();
-        std::cout << "Serial Time: " << serial_time_primes << " seconds" << std::endl;
+        std::cout << "Serial Time: " << serial_time_primes << " seconds (" << alloc << ")"
+                  << std::endl;
+        record_allocations(extra_results, "primes_serial", alloc);
     }
     
     // Parallel implementation (all ranks)
+    alloc = begin_kernel(arena);
+    MPI_Barrier(MPI_COMM_WORLD);
+    start_time = MPI_Wtime();
+    size_t parallel_prime_count;
+    {
+        auto primes_parallel = find_primes_parallel(PRIME_LIMIT, resource);
+        end_time = MPI_Wtime();
+        parallel_prime_count = primes_parallel.size();
+    }
+    if (g_rank == 0) {
+        parallel_time_primes = end_time - start_time;
+        std::cout << "Parallel Time: " << parallel_time_primes << " seconds (" << alloc << ")"
+                  << std::endl;
+        record_allocations(extra_results, "primes_parallel", alloc);
+    }
+    
+    // Segmented sieve over the same range, primes gathered on rank 0
+    size_t sieve_block = std::stoull(get_option(argc, argv, "--sieve-block-kb", "256")) << 10;
+    alloc = begin_kernel(arena);
+    MPI_Barrier(MPI_COMM_WORLD);
+    start_time = MPI_Wtime();
+    size_t sieve_prime_count;
+    {
+        auto primes_sieve = find_primes_sieve(PRIME_LIMIT, sieve_block, resource);
+        end_time = MPI_Wtime();
+        sieve_prime_count = primes_sieve.size();
+    }
+    if (g_rank == 0) {
+        double sieve_time = end_time - start_time;
+        std::cout << "Segmented Sieve Time: " << sieve_time << " seconds (" << alloc << ")"
+                  << std::endl;
+        if (sieve_prime_count != parallel_prime_count) {
+            std::cerr << "Segmented sieve found " << sieve_prime_count << " primes, expected "
+                      << parallel_prime_count << std::endl;
+        }
+        extra_results.emplace_back("primes_sieve", sieve_time);
+        record_allocations(extra_results, "primes_sieve", alloc);
+    }
+    
+    // Counting only: the sieve blocks are popcounted and the counts reduced, so the limit
+    // can go far beyond what fits in memory (e.g. --prime-count-limit 1000000000000)
+    uint64_t count_limit = std::stoull(get_option(argc, argv, "--prime-count-limit", "100000000"));
+    MPI_Pcontrol(1, "prime_count");
     MPI_Barrier(MPI_COMM_WORLD);
     start_time = MPI_Wtime();
     
-    auto primes_parallel = find_primes_parallel(PRIME_LIMIT);
+    uint64_t prime_count = count_primes_sieve(count_limit, sieve_block, true);
     
     end_time = MPI_Wtime();
     if (g_rank == 0) {
-        parallel_time_primes = end_time - start_time;
-        std::cout << "Parallel Time: " << parallel_time_primes << " seconds" << std::endl;
+        double count_time = end_time - start_time;
+        std::cout << "Prime Count: pi(" << count_limit << ") = " << prime_count << " in "
+                  << count_time << " seconds" << std::endl;
+        extra_results.emplace_back("prime_count_sieve", count_time);
+        extra_results.emplace_back("prime_count_limit", count_limit);
+        extra_results.emplace_back("prime_count", prime_count);
+        extra_results.emplace_back("sieve_block_kb", sieve_block >> 10);
     }
     
     // QuickSort test
+    MPI_Pcontrol(1, "sort");
     if (g_rank == 0) {
         std::cout << "\nC++ MPI QuickSort Test" << std::endl;
+    }
+    
+    // Every rank generates its own slice of the dataset; element i depends only on
+    // (seed, i), so the slices concatenate to exactly the array rank 0 sorts serially
+    CounterRng rng(seed);
+    std::pmr::vector<int> counts;
+    std::pmr::vector<int> displs;
+    block_partition(SORT_SIZE, counts, displs);
+    
+    MPI_Barrier(MPI_COMM_WORLD);
+    start_time = MPI_Wtime();
+    std::vector<int> local_array(counts[g_rank]);
+    if (dataset) {
+        std::copy(dataset->begin() + displs[g_rank],
+                  dataset->begin() + displs[g_rank] + counts[g_rank], local_array.begin());
+    } else {
+        fill_uniform_int(local_array.data(), counts[g_rank], displs[g_rank], rng, 1, 1000000, 1);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    end_time = MPI_Wtime();
+    double generate_time = end_time - start_time;
+    
+    if (!dataset_path.empty() && !dataset) {
+        save_mpi_dataset(dataset_path, local_array, SORT_SIZE, displs[g_rank], seed);
+    }
+    
+    if (g_rank == 0) {
+        std::cout << (dataset ? "Data Load Time: " : "Data Generation Time: ") << generate_time
+                  << " seconds (seed " << seed << ")" << std::endl;
+        if (!dataset_path.empty() && !dataset) {
+            std::cout << "Saved sort input to " << dataset_path << std::endl;
+        }
         
-        // Create test array
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(1, 1000000);
-        
+        // Serial implementation (only rank 0)
         std::vector<int> test_array(SORT_SIZE);
-        for (int i = 0; i < SORT_SIZE; i++) {
-            test_array[i] = dis(gen);
+        if (dataset) {
+            std::copy(dataset->begin(), dataset->end(), test_array.begin());
+        } else {
+            fill_uniform_int(test_array.data(), SORT_SIZE, 0, rng, 1, 1000000, 1);
         }
-        auto array_copy = test_array;
         
-        // Serial implementation (only rank 0)
+        alloc = begin_kernel(arena);
         auto start = std::chrono::high_resolution_clock::now();
-        quicksort_serial(test_array, 0, test_array.size() - 1);
+        quicksort_serial(test_array.begin(), test_array.end());
         auto end = std::chrono::high_resolution_clock::now();
         serial_time_sort = std::chrono::duration<double>(end - start).count();
-        std::cout << "Serial Time: " << serial_time_sort << " seconds" << std::endl;
-        
-        // Broadcast the unsorted array to all processes
-        MPI_Bcast(array_copy.data(), SORT_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
-        
-        // Parallel sorting
-        start_time = MPI_Wtime();
-        quicksort_parallel(array_copy);
-        end_time = MPI_Wtime();
+        std::cout << "Serial Time: " << serial_time_sort << " seconds (" << alloc << ")"
+                  << std::endl;
+        record_allocations(extra_results, "sort_serial", alloc);
+    }
+    
+    // Parallel sorting (all ranks)
+    std::vector<int> sorted_array(g_rank == 0 ? SORT_SIZE : 0);
+    alloc = begin_kernel(arena);
+    MPI_Barrier(MPI_COMM_WORLD);
+    start_time = MPI_Wtime();
+    quicksort_parallel(local_array, sorted_array, SORT_SIZE, resource);
+    end_time = MPI_Wtime();
+    
+    if (g_rank == 0) {
         parallel_time_sort = end_time - start_time;
-        std::cout << "Parallel Time: " << parallel_time_sort << " seconds" << std::endl;
-        
+        std::cout << "Parallel Time: " << parallel_time_sort << " seconds (" << alloc << ")"
+                  << std::endl;
+        record_allocations(extra_results, "sort_parallel", alloc);
+    }
+    
+    // MPI-IO sort test: file in, file out, the data is never collected on one rank
+    std::string io_input = get_option(argc, argv, "--mpi-io-input");
+    if (!io_input.empty()) {
+        MPI_Pcontrol(1, "mpi_io");
+        if (g_rank == 0) {
+            std::cout << "\nC++ MPI-IO Sort Test" << std::endl;
+        }
+        std::string io_generate = get_option(argc, argv, "--mpi-io-generate");
+        if (!io_generate.empty()) {
+            generate_mpi_io_input(io_input, std::stoll(io_generate), rng);
+        }
+        std::string io_output = get_option(argc, argv, "--mpi-io-output", io_input + ".sorted");
+        if (!run_mpi_io_sort(io_input, io_output, extra_results)) {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    
+    // Scaling test, opt-in: --scaling strong, weak or both
+    std::string scaling = get_option(argc, argv, "--scaling");
+    if (!scaling.empty()) {
+        if (g_rank == 0) {
+            std::cout << "\nC++ MPI Scaling Test" << std::endl;
+        }
+        int scaling_fib_n = std::stoi(get_option(argc, argv, "--scaling-fib-n", "1000000"));
+        uint64_t scaling_prime_limit =
+            std::stoull(get_option(argc, argv, "--scaling-prime-limit", "100000000"));
+        int scaling_sort_size = std::stoi(get_option(argc, argv, "--scaling-sort-size", "1000000"));
+        for (bool weak : {false, true}) {
+            if (scaling == "both" || scaling == (weak ? "weak" : "strong")) {
+                run_scaling(weak, scaling_fib_n, scaling_prime_limit, scaling_sort_size, seed,
+                            extra_results);
+            }
+        }
+    }
+    
+    // Topology test, opt-in: flat vs two-level collectives
+    if (has_flag(argc, argv, "--topology")) {
+        MPI_Pcontrol(1, "topology");
+        if (g_rank == 0) {
+            std::cout << "\nC++ MPI Topology Test" << std::endl;
+        }
+        int topology_reps = std::stoi(get_option(argc, argv, "--topology-reps", "5"));
+        run_topology(FIB_N, PRIME_LIMIT, SORT_SIZE, seed, topology_reps, sieve_block,
+                     extra_results);
+    }
+    
+    if (g_rank == 0) {
         // Write results to JSON file
         std::ofstream log_file("logs/cpp_mpi_results.json");
         log_file << "{\n";
         log_file << "  \"language\": \"C++ MPI\",\n";
         log_file << "  \"process_count\": " << g_world_size << ",\n";
+        log_file << "  \"seed\": " << seed << ",\n";
+        log_file << "  \"sort_size\": " << SORT_SIZE << ",\n";
+        log_file << "  \"arena\": " << (arena ? "true" : "false") << ",\n";
+        log_file << "  \"hierarchical\": " << (g_hierarchical ? "true" : "false") << ",\n";
+        log_file << "  \"data_generation\": " << generate_time << ",\n";
         log_file << "  \"fibonacci_serial\": " << serial_time_fib << ",\n";
         log_file << "  \"fibonacci_parallel\": " << parallel_time_fib << ",\n";
         log_file << "  \"primes_serial\": " << serial_time_primes << ",\n";
         log_file << "  \"primes_parallel\": " << parallel_time_primes << ",\n";
         log_file << "  \"sort_serial\": " << serial_time_sort << ",\n";
-        log_file << "  \"sort_parallel\": " << parallel_time_sort << "\n";
+        log_file << "  \"sort_parallel\": " << parallel_time_sort;
+        write_result_fields(log_file, extra_results);
+        log_file << "\n";
         log_file << "}\n";
         log_file.close();
-    } else {
-        // Non-root processes participate in the quicksort test
-        std::vector<int> dummy_array(SORT_SIZE);
-        MPI_Bcast(dummy_array.data(), SORT_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
-        quicksort_parallel(dummy_array);
     }
     
     // Finalize MPI
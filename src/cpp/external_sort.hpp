@@ -0,0 +1,323 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "sort_engine.hpp"
+
+// Out-of-core merge sort for files of raw binary keys (host byte order, no header).
+//
+// Phase 1 maps the input and sorts memory-budget sized chunks in place with
+// quicksort_parallel(), spilling each as a run file. Phase 2 k-way merges the runs; every run
+// and the output are double buffered so the next block is read (or the previous block
+// written) asynchronously while the merge consumes the current one. The fan-in is capped so
+// each block keeps at least kMinMergeBlock keys within the budget; more runs than that are
+// merged in several passes. With a checkpoint, the number of finished runs is saved as they
+// are spilled, and a resumed sort reuses those run files and continues with the next run.
+
+struct ExternalSortStats {
+    size_t runs = 0;
+    size_t resumed_runs = 0;
+    size_t merge_passes = 0;
+    size_t bytes_read = 0;
+    size_t bytes_written = 0;
+    double run_time = 0;
+    double merge_time = 0;
+};
+
+// Reads or writes exactly `bytes` at `offset`, throwing on failure
+inline void pread_all(int fd, void* data, size_t bytes, off_t offset) {
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t n = ::pread(fd, p, bytes, offset);
+        if (n <= 0) throw std::runtime_error("external sort: read failed");
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+}
+
+inline void write_all(int fd, const void* data, size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = ::write(fd, p, bytes);
+        if (n <= 0) throw std::runtime_error("external sort: write failed");
+        p += n;
+        bytes -= n;
+    }
+}
+
+inline int open_or_throw(const std::string& path, int flags) {
+    int fd = ::open(path.c_str(), flags, 0644);
+    if (fd < 0) throw std::runtime_error("external sort: cannot open " + path);
+    return fd;
+}
+
+// Size of the open file `fd` in bytes, closing it and throwing on failure
+inline size_t file_size_or_throw(int fd, const std::string& path) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("external sort: cannot stat " + path);
+    }
+    return st.st_size;
+}
+
+// Smallest merge block in keys; below it the per-block I/O overhead dominates
+constexpr size_t kMinMergeBlock = 1024;
+
+// Sequential reader over one sorted run with two buffers of `block` elements
+template <typename T>
+class RunReader {
+public:
+    RunReader(const std::string& path, size_t block) : block_(block) {
+        fd_ = open_or_throw(path, O_RDONLY);
+        remaining_ = file_size_or_throw(fd_, path) / sizeof(T);
+        buffers_[0].resize(block_);
+        buffers_[1].resize(block_);
+        len_ = fill(buffers_[0]);
+        prefetch();
+    }
+
+    ~RunReader() {
+        if (pending_.valid()) pending_.wait();
+        ::close(fd_);
+    }
+
+    bool empty() const { return pos_ == len_; }
+    const T& front() const { return buffers_[current_][pos_]; }
+
+    void pop() {
+        if (++pos_ == len_ && pending_.valid()) {
+            len_ = pending_.get();
+            current_ ^= 1;
+            pos_ = 0;
+            prefetch();
+        }
+    }
+
+private:
+    size_t fill(std::vector<T>& buffer) {
+        size_t count = std::min(block_, remaining_);
+        pread_all(fd_, buffer.data(), count * sizeof(T), offset_);
+        offset_ += count * sizeof(T);
+        remaining_ -= count;
+        return count;
+    }
+
+    void prefetch() {
+        if (remaining_ > 0) {
+            std::vector<T>& next = buffers_[current_ ^ 1];
+            pending_ = std::async(std::launch::async, [this, &next]() { return fill(next); });
+        }
+    }
+
+    int fd_;
+    size_t block_;
+    size_t remaining_;
+    off_t offset_ = 0;
+    std::vector<T> buffers_[2];
+    int current_ = 0;
+    size_t pos_ = 0;
+    size_t len_ = 0;
+    std::future<size_t> pending_;
+};
+
+// Sequential writer that flushes full blocks asynchronously while the next one fills
+template <typename T>
+class BlockWriter {
+public:
+    BlockWriter(const std::string& path, size_t block) : block_(block) {
+        fd_ = open_or_throw(path, O_WRONLY | O_CREAT | O_TRUNC);
+        buffers_[0].reserve(block_);
+        buffers_[1].reserve(block_);
+    }
+
+    ~BlockWriter() {
+        if (pending_.valid()) pending_.wait();
+        ::close(fd_);
+    }
+
+    void push(const T& value) {
+        buffers_[current_].push_back(value);
+        if (buffers_[current_].size() == block_) flush();
+    }
+
+    void flush() {
+        if (pending_.valid()) pending_.get();
+        std::vector<T>& full = buffers_[current_];
+        current_ ^= 1;
+        buffers_[current_].clear();
+        if (!full.empty()) {
+            bytes_written_ += full.size() * sizeof(T);
+            pending_ = std::async(std::launch::async, [this, &full]() {
+                write_all(fd_, full.data(), full.size() * sizeof(T));
+            });
+        }
+    }
+
+    // Flushes the partial block and waits for all writes
+    void finish() {
+        flush();
+        if (pending_.valid()) pending_.get();
+    }
+
+    size_t bytes_written() const { return bytes_written_; }
+
+private:
+    int fd_;
+    size_t block_;
+    std::vector<T> buffers_[2];
+    int current_ = 0;
+    size_t bytes_written_ = 0;
+    std::future<void> pending_;
+};
+
+// K-way merges the sorted runs in `paths` into `output` with blocks of `block` keys; returns
+// the number of keys written
+template <typename T>
+size_t merge_runs(const std::vector<std::string>& paths, const std::string& output, size_t block) {
+    std::vector<std::unique_ptr<RunReader<T>>> readers;
+    for (const auto& path : paths) {
+        readers.push_back(std::make_unique<RunReader<T>>(path, block));
+    }
+    BlockWriter<T> writer(output, block);
+
+    using Entry = std::pair<T, size_t>;
+    auto greater = [](const Entry& a, const Entry& b) { return b.first < a.first; };
+    std::priority_queue<Entry, std::vector<Entry>, decltype(greater)> heap(greater);
+    for (size_t r = 0; r < readers.size(); r++) {
+        if (!readers[r]->empty()) heap.emplace(readers[r]->front(), r);
+    }
+    while (!heap.empty()) {
+        size_t r = heap.top().second;
+        writer.push(heap.top().first);
+        heap.pop();
+        readers[r]->pop();
+        if (!readers[r]->empty()) heap.emplace(readers[r]->front(), r);
+    }
+    writer.finish();
+    return writer.bytes_written() / sizeof(T);
+}
+
+// Sorts the keys in `input` into `output` using about `memory_budget` bytes of buffers.
+// Run files are created in `temp_dir` and removed once merged.
+template <typename T>
+ExternalSortStats external_sort(const std::string& input, const std::string& output,
+                                size_t memory_budget, const std::string& temp_dir,
+                                Checkpoint* checkpoint = nullptr) {
+    ExternalSortStats stats;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    int fd = open_or_throw(input, O_RDONLY);
+    size_t total = file_size_or_throw(fd, input) / sizeof(T);
+
+    const T* keys = nullptr;
+    if (total > 0) {
+        void* mapped = mmap(nullptr, total * sizeof(T), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("external sort: cannot map " + input);
+        }
+        madvise(mapped, total * sizeof(T), MADV_SEQUENTIAL);
+        keys = static_cast<const T*>(mapped);
+    }
+
+    // The runs are sorted in place, so a run takes the whole budget
+    size_t run_size = std::max<size_t>(1, memory_budget / sizeof(T));
+    auto run_path = [&temp_dir](size_t r) {
+        return temp_dir + "/run_" + std::to_string(r) + ".bin";
+    };
+    std::vector<std::string> run_paths;
+    if (checkpoint && !checkpoint->restored().empty()) {
+        // Keep the checkpointed runs whose files are still there in full
+        size_t done = checkpoint->restored()[0];
+        for (size_t r = 0; r < done && r * run_size < total; r++) {
+            std::error_code error;
+            size_t expected = std::min(run_size, total - r * run_size) * sizeof(T);
+            if (std::filesystem::file_size(run_path(r), error) != expected) break;
+            run_paths.push_back(run_path(r));
+        }
+        stats.resumed_runs = run_paths.size();
+    }
+    std::vector<T> run;
+    for (size_t begin = run_paths.size() * run_size; begin < total; begin += run_size) {
+        size_t count = std::min(run_size, total - begin);
+        run.assign(keys + begin, keys + begin + count);
+        quicksort_parallel(run.begin(), run.end());
+
+        std::string path = run_path(run_paths.size());
+        int run_fd = open_or_throw(path, O_WRONLY | O_CREAT | O_TRUNC);
+        write_all(run_fd, run.data(), count * sizeof(T));
+        // A checkpoint may only count runs that are on disk
+        if (checkpoint && checkpoint->enabled()) fsync(run_fd);
+        ::close(run_fd);
+        run_paths.push_back(path);
+        stats.bytes_read += count * sizeof(T);
+        stats.bytes_written += count * sizeof(T);
+        if (checkpoint) checkpoint->save({run_paths.size()});
+    }
+    if (checkpoint) checkpoint->save({run_paths.size()}, true);
+    std::vector<T>().swap(run);
+    if (keys) munmap(const_cast<T*>(keys), total * sizeof(T));
+    ::close(fd);
+
+    auto runs_done = std::chrono::high_resolution_clock::now();
+    stats.run_time = std::chrono::duration<double>(runs_done - start).count();
+    stats.runs = run_paths.size();
+
+    // k readers and the writer each hold two blocks, so a pass merges at most max_fan_in runs
+    // with blocks of kMinMergeBlock keys or more
+    auto merge_block = [memory_budget](size_t fan_in) {
+        return std::max(kMinMergeBlock, memory_budget / (2 * (fan_in + 1) * sizeof(T)));
+    };
+    size_t slots = memory_budget / (2 * kMinMergeBlock * sizeof(T));
+    size_t max_fan_in = std::max<size_t>(2, slots > 1 ? slots - 1 : 0);
+    while (run_paths.size() > max_fan_in) {
+        std::vector<std::string> merged_paths;
+        for (size_t first = 0; first < run_paths.size(); first += max_fan_in) {
+            std::vector<std::string> group(
+                run_paths.begin() + first,
+                run_paths.begin() + std::min(first + max_fan_in, run_paths.size()));
+            std::string path = temp_dir + "/merge_" + std::to_string(stats.merge_passes) + "_" +
+                               std::to_string(merged_paths.size()) + ".bin";
+            size_t keys = merge_runs<T>(group, path, merge_block(group.size()));
+            stats.bytes_read += keys * sizeof(T);
+            stats.bytes_written += keys * sizeof(T);
+            for (const auto& run_file : group) {
+                std::filesystem::remove(run_file);
+            }
+            merged_paths.push_back(path);
+        }
+        run_paths.swap(merged_paths);
+        stats.merge_passes++;
+    }
+    size_t merged = merge_runs<T>(run_paths, output, merge_block(run_paths.size()));
+    stats.merge_passes++;
+    stats.bytes_read += merged * sizeof(T);
+    stats.bytes_written += merged * sizeof(T);
+    for (const auto& path : run_paths) {
+        std::filesystem::remove(path);
+    }
+    if (checkpoint) checkpoint->finish();
+
+    stats.merge_time = std::chrono::duration<double>(
+        std::chrono::high_resolution_clock::now() - runs_done).count();
+    return stats;
+}
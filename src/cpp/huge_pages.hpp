@@ -0,0 +1,159 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+// Page backing for large benchmark buffers, plus a dTLB miss counter to see its effect.
+//
+// "hugetlb" maps explicit 2 MB huge pages (needs pages reserved in vm.nr_hugepages), "thp"
+// maps 2 MB aligned memory and asks for transparent huge pages with MADV_HUGEPAGE, and
+// "regular" uses normal pages. If a policy cannot be satisfied the buffer falls back to the
+// next one down, and reports the policy it actually got.
+
+enum class PagePolicy { Regular, Transparent, HugeTlb };
+
+constexpr size_t kHugePageSize = size_t(2) << 20;
+
+inline PagePolicy parse_page_policy(const std::string& name) {
+    if (name == "hugetlb") return PagePolicy::HugeTlb;
+    if (name == "thp") return PagePolicy::Transparent;
+    return PagePolicy::Regular;
+}
+
+inline const char* page_policy_name(PagePolicy policy) {
+    switch (policy) {
+        case PagePolicy::HugeTlb: return "hugetlb";
+        case PagePolicy::Transparent: return "thp";
+        default: return "regular";
+    }
+}
+
+// Fixed-size mmap'ed array of trivially copyable T, faulted in at construction
+template <typename T>
+class PageBuffer {
+public:
+    PageBuffer(size_t count, PagePolicy policy) : count_(count) {
+        size_t bytes = std::max<size_t>(count * sizeof(T), 1);
+        if (policy == PagePolicy::HugeTlb) {
+            mapped_bytes_ = (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+            void* p = mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                map_base_ = p;
+                data_ = static_cast<T*>(p);
+                policy_ = PagePolicy::HugeTlb;
+            } else {
+                policy = PagePolicy::Transparent;
+            }
+        }
+        if (!data_ && policy == PagePolicy::Transparent) {
+            // Over-allocate so the buffer can start on a huge page boundary
+            mapped_bytes_ = bytes + kHugePageSize;
+            void* p = mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+            map_base_ = p;
+            uintptr_t aligned = (reinterpret_cast<uintptr_t>(p) + kHugePageSize - 1) &
+                                ~(kHugePageSize - 1);
+            data_ = reinterpret_cast<T*>(aligned);
+            policy_ = madvise(data_, bytes, MADV_HUGEPAGE) == 0 ? PagePolicy::Transparent
+                                                                : PagePolicy::Regular;
+        }
+        if (!data_) {
+            mapped_bytes_ = bytes;
+            void* p = mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+            map_base_ = p;
+            data_ = static_cast<T*>(p);
+            policy_ = PagePolicy::Regular;
+        }
+
+        // Pre-fault: touch every 4 KB page so first-touch faults stay out of the timings
+        char* bytes_ptr = reinterpret_cast<char*>(data_);
+        for (size_t offset = 0; offset < bytes; offset += 4096) {
+            bytes_ptr[offset] = 0;
+        }
+    }
+
+    ~PageBuffer() {
+        munmap(map_base_, mapped_bytes_);
+    }
+
+    PageBuffer(const PageBuffer&) = delete;
+    PageBuffer& operator=(const PageBuffer&) = delete;
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    size_t size() const { return count_; }
+    T* begin() { return data_; }
+    T* end() { return data_ + count_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + count_; }
+    T& operator[](size_t i) { return data_[i]; }
+
+    PagePolicy policy() const { return policy_; }
+
+private:
+    size_t count_;
+    size_t mapped_bytes_ = 0;
+    void* map_base_ = nullptr;
+    T* data_ = nullptr;
+    PagePolicy policy_ = PagePolicy::Regular;
+};
+
+// Data TLB read misses of this thread and the threads it creates while counting.
+// available() is false where perf events are not permitted (e.g. in many containers).
+class DtlbMissCounter {
+public:
+    DtlbMissCounter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~DtlbMissCounter() {
+        if (fd_ >= 0) close(fd_);
+    }
+
+    DtlbMissCounter(const DtlbMissCounter&) = delete;
+    DtlbMissCounter& operator=(const DtlbMissCounter&) = delete;
+
+    bool available() const { return fd_ >= 0; }
+
+    void start() {
+        if (fd_ < 0) return;
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    // Misses since start(), or -1 if unavailable
+    long long stop() {
+        if (fd_ < 0) return -1;
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if (read(fd_, &count, sizeof(count)) != sizeof(count)) return -1;
+        return count;
+    }
+
+private:
+    int fd_ = -1;
+};
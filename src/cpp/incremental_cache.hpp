@@ -0,0 +1,235 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "segmented_sieve.hpp"
+
+// Incremental prime and Fibonacci engines for sweeps over growing limits.
+//
+// Each engine keeps what it has computed and only computes the missing range when a query goes
+// beyond it, so a sweep costs about as much as its largest point rather than the sum of all
+// points. The state can live in a memory-mapped cache file, which later runs reopen and extend.
+
+// Growable array of uint64_t in anonymous memory or, given a path, in a shared file mapping.
+// A file starts with a 64-byte header: magic, kind, and the number of valid elements, which
+// is only raised once those elements are written.
+class PersistentArray {
+public:
+    // In memory only
+    PersistentArray() { map(kInitialCapacity); }
+
+    // Opens the cache file at `path`, or starts it if it is missing or holds another kind
+    PersistentArray(const std::string& path, uint64_t kind) : kind_(kind) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) throw std::runtime_error("cache: cannot open " + path);
+        struct stat st;
+        fstat(fd_, &st);
+        size_t capacity = kInitialCapacity;
+        bool valid = false;
+        if (static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+            capacity = std::max(capacity, (st.st_size - sizeof(Header)) / sizeof(uint64_t));
+            valid = true;
+        }
+        map(capacity);
+        if (!valid || header_->magic != kMagic || header_->kind != kind_ ||
+            header_->count > capacity_) {
+            *header_ = Header{kMagic, kind_, 0, {}};
+        }
+    }
+
+    ~PersistentArray() {
+        if (header_) munmap(header_, bytes(capacity_));
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    PersistentArray(const PersistentArray&) = delete;
+    PersistentArray& operator=(const PersistentArray&) = delete;
+
+    uint64_t* data() { return reinterpret_cast<uint64_t*>(header_ + 1); }
+    const uint64_t* data() const { return reinterpret_cast<const uint64_t*>(header_ + 1); }
+    size_t size() const { return header_->count; }
+    bool file_backed() const { return fd_ >= 0; }
+
+    // Makes room for n elements, keeping the current ones; capacity grows geometrically
+    void reserve(size_t n) {
+        if (n <= capacity_) return;
+        size_t capacity = std::max(n, capacity_ * 2);
+        size_t old_bytes = bytes(capacity_);
+        if (fd_ >= 0 && ftruncate(fd_, bytes(capacity)) != 0) {
+            throw std::runtime_error("cache: cannot grow file");
+        }
+        void* mapped = mremap(header_, old_bytes, bytes(capacity), MREMAP_MAYMOVE);
+        if (mapped == MAP_FAILED) throw std::runtime_error("cache: cannot grow mapping");
+        header_ = static_cast<Header*>(mapped);
+        capacity_ = capacity;
+    }
+
+    // Marks the first n elements valid (they must have been written)
+    void set_size(size_t n) { header_->count = n; }
+
+private:
+    struct Header {
+        uint64_t magic;
+        uint64_t kind;
+        uint64_t count;
+        uint64_t reserved[5];
+    };
+    static constexpr uint64_t kMagic = 0x4843414345434e49; // "INCECACH"
+    static constexpr size_t kInitialCapacity = 1 << 12;
+
+    static size_t bytes(size_t capacity) { return sizeof(Header) + capacity * sizeof(uint64_t); }
+
+    void map(size_t capacity) {
+        void* mapped;
+        if (fd_ >= 0) {
+            struct stat st;
+            fstat(fd_, &st);
+            if (static_cast<size_t>(st.st_size) < bytes(capacity) &&
+                ftruncate(fd_, bytes(capacity)) != 0) {
+                throw std::runtime_error("cache: cannot size file");
+            }
+            mapped = mmap(nullptr, bytes(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        } else {
+            mapped = mmap(nullptr, bytes(capacity), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        if (mapped == MAP_FAILED) throw std::runtime_error("cache: cannot map");
+        header_ = static_cast<Header*>(mapped);
+        capacity_ = capacity;
+        if (fd_ < 0) *header_ = Header{kMagic, kind_, 0, {}};
+    }
+
+    int fd_ = -1;
+    uint64_t kind_ = 0;
+    Header* header_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+// pi(x) over a prime bitmap that is extended by segmented sieving as queries grow. Word w holds
+// the odd numbers in [128w, 128w + 128); a running count per word is rebuilt on load.
+class IncrementalPrimes {
+public:
+    explicit IncrementalPrimes(unsigned num_threads) : num_threads_(std::max(1u, num_threads)) {
+        load();
+    }
+
+    IncrementalPrimes(const std::string& cache_path, unsigned num_threads)
+        : bits_(cache_path, kKind), num_threads_(std::max(1u, num_threads)) {
+        load();
+    }
+
+    // Largest number the bitmap covers so far
+    uint64_t covered() const { return bits_.size() * 128 - 1; }
+
+    uint64_t pi(uint64_t x) {
+        if (x < 2) return 0;
+        if (x > covered()) extend(x);
+        uint64_t last = (x - 1) / 2;
+        uint64_t word = bits_.data()[last / 64] & (~uint64_t(0) >> (63 - last % 64));
+        return 1 + counts_[last / 64] + __builtin_popcountll(word);
+    }
+
+    // Sieves only the words beyond the current bitmap, split across threads
+    void extend(uint64_t limit) {
+        size_t old_words = bits_.size();
+        size_t words = (limit / 2) / 64 + 1;
+        if (words <= old_words) return;
+        bits_.reserve(words);
+        uint64_t* out = bits_.data();
+        std::vector<uint32_t> primes = base_primes(static_cast<uint32_t>(isqrt(words * 128)));
+
+        size_t words_per_thread = (words - old_words + num_threads_ - 1) / num_threads_;
+        std::vector<std::future<void>> futures;
+        for (size_t first_word = old_words; first_word < words; first_word += words_per_thread) {
+            uint64_t lo = first_word * 128;
+            uint64_t hi = std::min(words, first_word + words_per_thread) * 128;
+            futures.push_back(std::async(std::launch::async, [out, &primes, lo, hi]() {
+                sieve_segments(lo, hi, primes, kSieveBlockBytes,
+                               [out](uint64_t first, const uint64_t* block, uint64_t bits) {
+                    std::copy(block, block + (bits + 63) / 64, out + first / 128);
+                });
+            }));
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+        bits_.set_size(words);
+        count_words(old_words);
+    }
+
+private:
+    static constexpr uint64_t kKind = 1;
+
+    void load() {
+        if (bits_.size() == 0) {
+            extend(127);
+        } else {
+            count_words(0);
+        }
+    }
+
+    void count_words(size_t first_word) {
+        uint64_t running = first_word == 0 ? 0
+            : counts_[first_word - 1] + __builtin_popcountll(bits_.data()[first_word - 1]);
+        counts_.resize(bits_.size());
+        for (size_t w = first_word; w < bits_.size(); w++) {
+            counts_[w] = running;
+            running += __builtin_popcountll(bits_.data()[w]);
+        }
+    }
+
+    PersistentArray bits_;
+    std::vector<uint64_t> counts_;
+    unsigned num_threads_;
+};
+
+// F(0), F(1), ... mod 2^64, extended with the recurrence from the last two known values
+class IncrementalFibonacci {
+public:
+    IncrementalFibonacci() { load(); }
+    explicit IncrementalFibonacci(const std::string& cache_path) : values_(cache_path, kKind) {
+        load();
+    }
+
+    size_t known() const { return values_.size(); }
+
+    uint64_t operator()(size_t n) {
+        if (n >= values_.size()) extend(n);
+        return values_.data()[n];
+    }
+
+    void extend(size_t n) {
+        size_t old_size = values_.size();
+        if (n < old_size) return;
+        values_.reserve(n + 1);
+        uint64_t* f = values_.data();
+        for (size_t i = old_size; i <= n; i++) {
+            f[i] = f[i - 1] + f[i - 2];
+        }
+        values_.set_size(n + 1);
+    }
+
+private:
+    static constexpr uint64_t kKind = 2;
+
+    void load() {
+        if (values_.size() < 2) {
+            values_.data()[0] = 0;
+            values_.data()[1] = 1;
+            values_.set_size(2);
+        }
+    }
+
+    PersistentArray values_;
+};
@@ -0,0 +1,529 @@
+// PMPI profiling layer for the MPI benchmark.
+//
+// Linking this file (bin/libmpi_profile.a) in front of the MPI library replaces the MPI calls
+// the benchmark makes with wrappers that time the matching PMPI_ call. It is enabled by passing
+// `--mpi-profile PATH` to the program (read in MPI_Init); otherwise the wrappers only forward.
+//
+// Every rank keeps, per kernel phase and per call, the number of calls, the bytes it sent and
+// received and a histogram of call times. It also keeps the bytes it sent to each world rank.
+// Collectives are counted by their logical payload, for example a broadcast sends count
+// elements from the root to every other rank, whatever algorithm the MPI library uses. The
+// program names phases with MPI_Pcontrol(1, "name"), which is a no-op without this layer.
+// MPI_Finalize gathers everything on rank 0, writes it to PATH as JSON and prints a summary
+// and the rank x rank traffic matrix.
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_args.hpp"
+
+namespace {
+
+// Bucket 0 is under 1 us; bucket b >= 1 is [2^(b-1), 2^b) us; the last one is open-ended
+constexpr int kTimeBuckets = 24;
+
+enum Call {
+    kSend, kRecv, kBarrier, kBcast, kReduce, kAllreduce, kExscan, kGather, kGatherv, kScatterv,
+    kAllgather, kAllgatherv, kAlltoall, kAlltoallv, kCallCount
+};
+const char* const kCallNames[kCallCount] = {
+    "MPI_Send", "MPI_Recv", "MPI_Barrier", "MPI_Bcast", "MPI_Reduce", "MPI_Allreduce",
+    "MPI_Exscan", "MPI_Gather", "MPI_Gatherv", "MPI_Scatterv", "MPI_Allgather",
+    "MPI_Allgatherv", "MPI_Alltoall", "MPI_Alltoallv"};
+
+struct CallStats {
+    uint64_t calls = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+    double seconds = 0;
+    uint64_t histogram[kTimeBuckets] = {};
+};
+
+struct Profile {
+    bool enabled = false;
+    std::string path;
+    int world_rank = 0;
+    int world_size = 1;
+    std::string phase = "main";
+    std::map<std::pair<std::string, int>, CallStats> stats;
+    std::vector<uint64_t> sent_to; // bytes this rank sent to each world rank
+};
+
+Profile g_profile;
+
+int type_size(MPI_Datatype type) {
+    int size = 0;
+    PMPI_Type_size(type, &size);
+    return size;
+}
+
+int comm_rank(MPI_Comm comm) {
+    int rank = 0;
+    PMPI_Comm_rank(comm, &rank);
+    return rank;
+}
+
+int comm_size(MPI_Comm comm) {
+    int size = 1;
+    PMPI_Comm_size(comm, &size);
+    return size;
+}
+
+// World rank of `rank` in `comm`
+int world_rank(MPI_Comm comm, int rank) {
+    if (comm == MPI_COMM_WORLD) return rank;
+    MPI_Group group, world;
+    PMPI_Comm_group(comm, &group);
+    PMPI_Comm_group(MPI_COMM_WORLD, &world);
+    int result = rank;
+    PMPI_Group_translate_ranks(group, 1, &rank, world, &result);
+    PMPI_Group_free(&group);
+    PMPI_Group_free(&world);
+    return result;
+}
+
+// Accumulates what one call moved; `to` lists (rank in comm, bytes) pairs sent by this rank
+class CallRecord {
+public:
+    CallRecord(Call call, MPI_Comm comm) : call_(call), comm_(comm), start_(PMPI_Wtime()) {}
+
+    void sent(int rank, uint64_t bytes) {
+        if (bytes == 0) return;
+        to_.emplace_back(rank, bytes);
+        bytes_sent_ += bytes;
+    }
+    void received(uint64_t bytes) { bytes_received_ += bytes; }
+
+    void finish() {
+        double seconds = PMPI_Wtime() - start_;
+        CallStats& stats = g_profile.stats[{g_profile.phase, call_}];
+        stats.calls++;
+        stats.bytes_sent += bytes_sent_;
+        stats.bytes_received += bytes_received_;
+        stats.seconds += seconds;
+        int bucket = 0;
+        for (double us = seconds * 1e6; us >= 1 && bucket < kTimeBuckets - 1; us /= 2) bucket++;
+        stats.histogram[bucket]++;
+        for (const auto& [rank, bytes] : to_) {
+            g_profile.sent_to[world_rank(comm_, rank)] += bytes;
+        }
+    }
+
+private:
+    Call call_;
+    MPI_Comm comm_;
+    double start_;
+    uint64_t bytes_sent_ = 0;
+    uint64_t bytes_received_ = 0;
+    std::vector<std::pair<int, uint64_t>> to_;
+};
+
+// Serializes this rank's stats as lines of "phase call calls sent received seconds h0 .. h23"
+std::string serialize_stats() {
+    std::ostringstream out;
+    out << std::setprecision(17);
+    for (const auto& [key, stats] : g_profile.stats) {
+        out << key.first << ' ' << key.second << ' ' << stats.calls << ' ' << stats.bytes_sent
+            << ' ' << stats.bytes_received << ' ' << stats.seconds;
+        for (uint64_t count : stats.histogram) out << ' ' << count;
+        out << '\n';
+    }
+    return out.str();
+}
+
+struct MergedStats {
+    std::vector<uint64_t> calls, bytes_sent, bytes_received;
+    std::vector<double> seconds;
+    uint64_t histogram[kTimeBuckets] = {};
+};
+
+void write_profile(const std::map<std::pair<std::string, int>, MergedStats>& merged,
+                   const std::vector<uint64_t>& traffic, int size) {
+    std::ofstream out(g_profile.path);
+    auto write_array = [&out](const auto& values) {
+        out << '[';
+        for (size_t i = 0; i < values.size(); i++) out << (i ? ", " : "") << values[i];
+        out << ']';
+    };
+    out << "{\n  \"ranks\": " << size << ",\n";
+    out << "  \"histogram_bucket_us\": \"0: <1, b: [2^(b-1), 2^b)\",\n";
+    out << "  \"calls\": [";
+    bool first = true;
+    for (const auto& [key, stats] : merged) {
+        out << (first ? "\n" : ",\n") << "    {\"phase\": \"" << key.first << "\", \"call\": \""
+            << kCallNames[key.second] << "\", \"calls\": ";
+        write_array(stats.calls);
+        out << ", \"bytes_sent\": ";
+        write_array(stats.bytes_sent);
+        out << ", \"bytes_received\": ";
+        write_array(stats.bytes_received);
+        out << ", \"seconds\": ";
+        write_array(stats.seconds);
+        out << ", \"histogram\": ";
+        write_array(std::vector<uint64_t>(stats.histogram, stats.histogram + kTimeBuckets));
+        out << '}';
+        first = false;
+    }
+    out << "\n  ],\n  \"traffic_bytes\": [";
+    for (int from = 0; from < size; from++) {
+        out << (from ? ",\n    " : "\n    ");
+        write_array(std::vector<uint64_t>(traffic.begin() + from * size,
+                                          traffic.begin() + (from + 1) * size));
+    }
+    out << "\n  ]\n}\n";
+}
+
+void print_summary(const std::map<std::pair<std::string, int>, MergedStats>& merged,
+                   const std::vector<uint64_t>& traffic, int size) {
+    std::cout << "\nMPI Profile (" << g_profile.path << ")" << std::endl;
+    for (const auto& [key, stats] : merged) {
+        uint64_t calls = 0, sent = 0;
+        double seconds = 0, slowest = 0;
+        for (int r = 0; r < size; r++) {
+            calls += stats.calls[r];
+            sent += stats.bytes_sent[r];
+            seconds += stats.seconds[r];
+            slowest = std::max(slowest, stats.seconds[r]);
+        }
+        std::cout << "  " << key.first << " " << kCallNames[key.second] << ": " << calls
+                  << " calls, " << sent << " bytes sent, " << seconds
+                  << " seconds in total (slowest rank " << slowest << ")" << std::endl;
+    }
+    std::cout << "  Traffic matrix (bytes, row = sender):" << std::endl;
+    for (int from = 0; from < size; from++) {
+        std::cout << "   ";
+        for (int to = 0; to < size; to++) {
+            std::cout << ' ' << std::setw(12) << traffic[from * size + to];
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Gathers every rank's stats and traffic row on rank 0 and reports them
+void report() {
+    int rank = g_profile.world_rank;
+    int size = g_profile.world_size;
+    std::string text = serialize_stats();
+    int length = static_cast<int>(text.size());
+    std::vector<int> lengths(size), displs(size);
+    PMPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::vector<char> all_text;
+    if (rank == 0) {
+        for (int r = 1; r < size; r++) displs[r] = displs[r - 1] + lengths[r - 1];
+        all_text.resize(displs[size - 1] + lengths[size - 1]);
+    }
+    PMPI_Gatherv(text.data(), length, MPI_CHAR, all_text.data(), lengths.data(), displs.data(),
+                 MPI_CHAR, 0, MPI_COMM_WORLD);
+    std::vector<uint64_t> traffic(rank == 0 ? size * size : 0);
+    PMPI_Gather(g_profile.sent_to.data(), size, MPI_UINT64_T, traffic.data(), size,
+                MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (rank != 0) return;
+
+    std::map<std::pair<std::string, int>, MergedStats> merged;
+    for (int r = 0; r < size; r++) {
+        std::istringstream in(std::string(all_text.data() + displs[r], lengths[r]));
+        std::string phase;
+        int call;
+        while (in >> phase >> call) {
+            MergedStats& stats = merged[{phase, call}];
+            if (stats.calls.empty()) {
+                stats.calls.assign(size, 0);
+                stats.bytes_sent.assign(size, 0);
+                stats.bytes_received.assign(size, 0);
+                stats.seconds.assign(size, 0);
+            }
+            in >> stats.calls[r] >> stats.bytes_sent[r] >> stats.bytes_received[r] >>
+                stats.seconds[r];
+            for (uint64_t& count : stats.histogram) {
+                uint64_t value;
+                in >> value;
+                count += value;
+            }
+        }
+    }
+    write_profile(merged, traffic, size);
+    print_summary(merged, traffic, size);
+}
+
+} // namespace
+
+extern "C" {
+
+int MPI_Init(int* argc, char*** argv) {
+    int result = PMPI_Init(argc, argv);
+    if (argc && argv) {
+        g_profile.path = get_option(*argc, *argv, "--mpi-profile");
+        g_profile.enabled = !g_profile.path.empty();
+    }
+    PMPI_Comm_rank(MPI_COMM_WORLD, &g_profile.world_rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &g_profile.world_size);
+    g_profile.sent_to.assign(g_profile.world_size, 0);
+    return result;
+}
+
+int MPI_Finalize() {
+    if (g_profile.enabled) report();
+    return PMPI_Finalize();
+}
+
+// Level 1 with a phase name starts that phase; phase names must not contain spaces
+int MPI_Pcontrol(const int level, ...) {
+    if (level == 1) {
+        va_list args;
+        va_start(args, level);
+        const char* name = va_arg(args, const char*);
+        va_end(args);
+        if (name) g_profile.phase = name;
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Send(const void* buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm) {
+    if (!g_profile.enabled) return PMPI_Send(buf, count, type, dest, tag, comm);
+    CallRecord record(kSend, comm);
+    int result = PMPI_Send(buf, count, type, dest, tag, comm);
+    record.sent(dest, uint64_t(count) * type_size(type));
+    record.finish();
+    return result;
+}
+
+int MPI_Recv(void* buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm,
+             MPI_Status* status) {
+    if (!g_profile.enabled) return PMPI_Recv(buf, count, type, source, tag, comm, status);
+    CallRecord record(kRecv, comm);
+    MPI_Status local_status;
+    if (status == MPI_STATUS_IGNORE) status = &local_status;
+    int result = PMPI_Recv(buf, count, type, source, tag, comm, status);
+    int received = 0;
+    PMPI_Get_count(status, MPI_BYTE, &received);
+    record.received(received);
+    record.finish();
+    return result;
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+    if (!g_profile.enabled) return PMPI_Barrier(comm);
+    CallRecord record(kBarrier, comm);
+    int result = PMPI_Barrier(comm);
+    record.finish();
+    return result;
+}
+
+int MPI_Bcast(void* buffer, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+    if (!g_profile.enabled) return PMPI_Bcast(buffer, count, type, root, comm);
+    CallRecord record(kBcast, comm);
+    int result = PMPI_Bcast(buffer, count, type, root, comm);
+    uint64_t bytes = uint64_t(count) * type_size(type);
+    if (comm_rank(comm) == root) {
+        for (int r = 0; r < comm_size(comm); r++) {
+            if (r != root) record.sent(r, bytes);
+        }
+    } else {
+        record.received(bytes);
+    }
+    record.finish();
+    return result;
+}
+
+int MPI_Reduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op,
+               int root, MPI_Comm comm) {
+    if (!g_profile.enabled) return PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+    CallRecord record(kReduce, comm);
+    int result = PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+    uint64_t bytes = uint64_t(count) * type_size(type);
+    if (comm_rank(comm) == root) {
+        record.received(bytes * (comm_size(comm) - 1));
+    } else {
+        record.sent(root, bytes);
+    }
+    record.finish();
+    return result;
+}
+
+// Every rank's contribution reaches every other rank
+int MPI_Allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op,
+                  MPI_Comm comm) {
+    if (!g_profile.enabled) return PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+    CallRecord record(kAllreduce, comm);
+    int result = PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+    int rank = comm_rank(comm);
+    int size = comm_size(comm);
+    uint64_t bytes = uint64_t(count) * type_size(type);
+    for (int r = 0; r < size; r++) {
+        if (r != rank) record.sent(r, bytes);
+    }
+    record.received(bytes * (size - 1));
+    record.finish();
+    return result;
+}
+
+// Rank r's contribution reaches the ranks above it, and it receives those of the ranks below
+int MPI_Exscan(const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op,
+               MPI_Comm comm) {
+    if (!g_profile.enabled) return PMPI_Exscan(sendbuf, recvbuf, count, type, op, comm);
+    CallRecord record(kExscan, comm);
+    int result = PMPI_Exscan(sendbuf, recvbuf, count, type, op, comm);
+    int rank = comm_rank(comm);
+    uint64_t bytes = uint64_t(count) * type_size(type);
+    for (int r = rank + 1; r < comm_size(comm); r++) {
+        record.sent(r, bytes);
+    }
+    record.received(bytes * rank);
+    record.finish();
+    return result;
+}
+
+int MPI_Gather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+               int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    if (!g_profile.enabled) {
+        return PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root,
+                           comm);
+    }
+    CallRecord record(kGather, comm);
+    int result = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root,
+                             comm);
+    if (comm_rank(comm) == root) {
+        record.received(uint64_t(recvcount) * type_size(recvtype) * (comm_size(comm) - 1));
+    } else {
+        record.sent(root, uint64_t(sendcount) * type_size(sendtype));
+    }
+    record.finish();
+    return result;
+}
+
+int MPI_Gatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                const int recvcounts[], const int displs[], MPI_Datatype recvtype, int root,
+                MPI_Comm comm) {
+    if (!g_profile.enabled) {
+        return PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype,
+                            root, comm);
+    }
+    CallRecord record(kGatherv, comm);
+    int result = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs,
+                              recvtype, root, comm);
+    int rank = comm_rank(comm);
+    if (rank == root) {
+        for (int r = 0; r < comm_size(comm); r++) {
+            if (r != root) record.received(uint64_t(recvcounts[r]) * type_size(recvtype));
+        }
+    } else {
+        record.sent(root, uint64_t(sendcount) * type_size(sendtype));
+    }
+    record.finish();
+    return result;
+}
+
+int MPI_Scatterv(const void* sendbuf, const int sendcounts[], const int displs[],
+                 MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype,
+                 int root, MPI_Comm comm) {
+    if (!g_profile.enabled) {
+        return PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount,
+                             recvtype, root, comm);
+    }
+    CallRecord record(kScatterv, comm);
+    int result = PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount,
+                               recvtype, root, comm);
+    if (comm_rank(comm) == root) {
+        for (int r = 0; r < comm_size(comm); r++) {
+            if (r != root) record.sent(r, uint64_t(sendcounts[r]) * type_size(sendtype));
+        }
+    } else {
+        record.received(uint64_t(recvcount) * type_size(recvtype));
+    }
+    record.finish();
+    return result;
+}
+
+int MPI_Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                  int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+    if (!g_profile.enabled) {
+        return PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    }
+    CallRecord record(kAllgather, comm);
+    int result = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
+                                comm);
+    int rank = comm_rank(comm);
+    int size = comm_size(comm);
+    uint64_t bytes = uint64_t(recvcount) * type_size(recvtype);
+    for (int r = 0; r < size; r++) {
+        if (r != rank) record.sent(r, bytes);
+    }
+    record.received(bytes * (size - 1));
+    record.finish();
+    return result;
+}
+
+int MPI_Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                   const int recvcounts[], const int displs[], MPI_Datatype recvtype,
+                   MPI_Comm comm) {
+    if (!g_profile.enabled) {
+        return PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs,
+                               recvtype, comm);
+    }
+    CallRecord record(kAllgatherv, comm);
+    int result = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs,
+                                 recvtype, comm);
+    int rank = comm_rank(comm);
+    int size = comm_size(comm);
+    int element = type_size(recvtype);
+    for (int r = 0; r < size; r++) {
+        if (r == rank) continue;
+        record.sent(r, uint64_t(recvcounts[rank]) * element);
+        record.received(uint64_t(recvcounts[r]) * element);
+    }
+    record.finish();
+    return result;
+}
+
+int MPI_Alltoall(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                 int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+    if (!g_profile.enabled) {
+        return PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    }
+    CallRecord record(kAlltoall, comm);
+    int result = PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
+                               comm);
+    int rank = comm_rank(comm);
+    int size = comm_size(comm);
+    for (int r = 0; r < size; r++) {
+        if (r == rank) continue;
+        record.sent(r, uint64_t(sendcount) * type_size(sendtype));
+        record.received(uint64_t(recvcount) * type_size(recvtype));
+    }
+    record.finish();
+    return result;
+}
+
+int MPI_Alltoallv(const void* sendbuf, const int sendcounts[], const int sdispls[],
+                  MPI_Datatype sendtype, void* recvbuf, const int recvcounts[],
+                  const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm) {
+    if (!g_profile.enabled) {
+        return PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts,
+                              rdispls, recvtype, comm);
+    }
+    CallRecord record(kAlltoallv, comm);
+    int result = PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts,
+                                rdispls, recvtype, comm);
+    int rank = comm_rank(comm);
+    int size = comm_size(comm);
+    for (int r = 0; r < size; r++) {
+        if (r == rank) continue;
+        record.sent(r, uint64_t(sendcounts[r]) * type_size(sendtype));
+        record.received(uint64_t(recvcounts[r]) * type_size(recvtype));
+    }
+    record.finish();
+    return result;
+}
+
+} // extern "C"
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Single-number primality tests for sparse queries.
+//
+// is_prime() is trial division over a 2·3·5 wheel (8 candidates per 30 numbers, no sqrt in
+// the loop) and is what the enumeration kernels use. is_prime_u64() handles any 64-bit
+// input: multiply-only trial division by a small prime table, then deterministic Miller–Rabin in
+// Montgomery form. is_prime_batch() runs the Miller–Rabin rounds for kPrimalityLanes
+// candidates in lockstep, which keeps that many independent multiply chains in flight.
+
+// Residues mod 30 coprime to 30, and the gaps between consecutive ones starting from 7
+constexpr int kWheelGaps[8] = {4, 2, 4, 2, 4, 6, 2, 6};
+
+inline bool is_prime(int64_t n) {
+    if (n < 2) return false;
+    if (n % 2 == 0) return n == 2;
+    if (n % 3 == 0) return n == 3;
+    if (n % 5 == 0) return n == 5;
+    int64_t i = 7;
+    for (int w = 0; i * i <= n; i += kWheelGaps[w], w = (w + 1) & 7) {
+        if (n % i == 0) return false;
+    }
+    return true;
+}
+
+// Odd primes below 256 with the constants for a division-free divisibility test: for odd p,
+// p divides n exactly when n * p^-1 (mod 2^64) <= (2^64 - 1) / p
+struct SmallPrime {
+    uint64_t p;
+    uint64_t inverse;
+    uint64_t limit;
+};
+
+inline const std::vector<SmallPrime>& small_primes() {
+    static const std::vector<SmallPrime> primes = [] {
+        std::vector<SmallPrime> result;
+        for (uint64_t p = 3; p < 256; p += 2) {
+            if (!is_prime(p)) continue;
+            uint64_t inverse = p;
+            for (int i = 0; i < 5; i++) inverse *= 2 - p * inverse;
+            result.push_back({p, inverse, UINT64_MAX / p});
+        }
+        return result;
+    }();
+    return primes;
+}
+
+// 1 = prime, 0 = composite, -1 = no small factor and too large to decide
+inline int trial_divide_small(uint64_t n) {
+    if (n < 2) return 0;
+    if (n % 2 == 0) return n == 2;
+    for (const SmallPrime& sp : small_primes()) {
+        if (n * sp.inverse <= sp.limit) return n == sp.p;
+    }
+    return n < 256 * 256 ? 1 : -1;
+}
+
+// Montgomery arithmetic modulo an odd 64-bit n with R = 2^64
+struct Montgomery {
+    uint64_t n;
+    uint64_t n_inv; // n^-1 mod 2^64
+    uint64_t r2;    // R^2 mod n
+    uint64_t one;   // R mod n, i.e. 1 in Montgomery form
+
+    explicit Montgomery(uint64_t modulus) : n(modulus) {
+        n_inv = n; // correct to 3 bits for odd n; each Newton step doubles that
+        for (int i = 0; i < 5; i++) n_inv *= 2 - n * n_inv;
+        one = (0 - n) % n;
+        r2 = static_cast<uint64_t>(static_cast<unsigned __int128>(one) * one % n);
+    }
+
+    // t * R^-1 mod n for t < n * R
+    uint64_t reduce(unsigned __int128 t) const {
+        uint64_t m = static_cast<uint64_t>(t) * n_inv;
+        uint64_t mn_hi = static_cast<uint64_t>((static_cast<unsigned __int128>(m) * n) >> 64);
+        uint64_t t_hi = static_cast<uint64_t>(t >> 64);
+        return t_hi >= mn_hi ? t_hi - mn_hi : t_hi - mn_hi + n;
+    }
+
+    uint64_t mul(uint64_t a, uint64_t b) const {
+        return reduce(static_cast<unsigned __int128>(a) * b);
+    }
+
+    uint64_t to_mont(uint64_t a) const { return mul(a % n, r2); }
+
+    uint64_t pow(uint64_t base, uint64_t e) const {
+        uint64_t result = one;
+        while (e > 0) {
+            if (e & 1) result = mul(result, base);
+            base = mul(base, base);
+            e >>= 1;
+        }
+        return result;
+    }
+};
+
+// Bases that make Miller–Rabin deterministic for every n < 2^64 (Sinclair)
+constexpr uint64_t kMillerRabinBases[7] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+
+// Miller–Rabin for odd n > 2 with no small factors, using the bases from `first_base` on
+inline bool miller_rabin(uint64_t n, int first_base = 0) {
+    Montgomery mont(n);
+    uint64_t d = n - 1;
+    int s = __builtin_ctzll(d);
+    d >>= s;
+    uint64_t minus_one = n - mont.one;
+
+    for (int i = first_base; i < 7; i++) {
+        uint64_t a = kMillerRabinBases[i];
+        if (a % n == 0) continue;
+        uint64_t x = mont.pow(mont.to_mont(a), d);
+        if (x == mont.one || x == minus_one) continue;
+        bool witness = true;
+        for (int r = 1; r < s && witness; r++) {
+            x = mont.mul(x, x);
+            if (x == minus_one) witness = false;
+        }
+        if (witness) return false;
+    }
+    return true;
+}
+
+inline bool is_prime_u64(uint64_t n) {
+    int small = trial_divide_small(n);
+    if (small >= 0) return small == 1;
+    return miller_rabin(n);
+}
+
+constexpr int kPrimalityLanes = 8;
+
+// Strong probable prime test to base `a` for kPrimalityLanes odd candidates in lockstep.
+// Lanes with shorter exponents start with zero digits, so all lanes share control flow.
+inline void strong_probable_prime_lanes(const uint64_t* n, uint64_t a, bool* probable) {
+    constexpr int L = kPrimalityLanes;
+    uint64_t n_inv[L], one[L], minus_one[L], d[L], base[L], x[L];
+    int s[L];
+    int s_max = 0;
+    int top_bit = 0;
+    for (int l = 0; l < L; l++) {
+        Montgomery mont(n[l]);
+        n_inv[l] = mont.n_inv;
+        one[l] = mont.one;
+        minus_one[l] = n[l] - mont.one;
+        base[l] = mont.to_mont(a);
+        x[l] = mont.one;
+        s[l] = __builtin_ctzll(n[l] - 1);
+        d[l] = (n[l] - 1) >> s[l];
+        s_max = std::max(s_max, s[l]);
+        top_bit = std::max(top_bit, 63 - __builtin_clzll(d[l]));
+    }
+    auto mul = [&](int l, uint64_t a, uint64_t b) {
+        unsigned __int128 t = static_cast<unsigned __int128>(a) * b;
+        uint64_t m = static_cast<uint64_t>(t) * n_inv[l];
+        uint64_t mn_hi = static_cast<uint64_t>((static_cast<unsigned __int128>(m) * n[l]) >> 64);
+        uint64_t t_hi = static_cast<uint64_t>(t >> 64);
+        return t_hi - mn_hi + (n[l] & (0 - uint64_t(t_hi < mn_hi)));
+    };
+
+    // base^d with fixed 4-bit windows: 4 squarings and one table multiply per digit
+    uint64_t powers[L][16];
+    for (int l = 0; l < L; l++) {
+        powers[l][0] = one[l];
+        for (int k = 1; k < 16; k++) powers[l][k] = mul(l, powers[l][k - 1], base[l]);
+    }
+    for (int shift = top_bit / 4 * 4; shift >= 0; shift -= 4) {
+        for (int l = 0; l < L; l++) {
+            uint64_t y = mul(l, x[l], x[l]);
+            y = mul(l, y, y);
+            y = mul(l, y, y);
+            y = mul(l, y, y);
+            x[l] = mul(l, y, powers[l][(d[l] >> shift) & 15]);
+        }
+    }
+    for (int l = 0; l < L; l++) {
+        // a ≡ 0 (mod n) says nothing about n, so such a lane passes
+        probable[l] = base[l] == 0 || x[l] == one[l] || x[l] == minus_one[l];
+    }
+    for (int r = 1; r < s_max; r++) {
+        for (int l = 0; l < L; l++) {
+            bool active = r < s[l] && !probable[l];
+            uint64_t sq = mul(l, x[l], x[l]);
+            x[l] = active ? sq : x[l];
+            probable[l] = probable[l] || (active && sq == minus_one[l]);
+        }
+    }
+}
+
+// prime[i] = is_prime_u64(n[i]) for i in [0, count). Candidates that survive trial division
+// are grouped for a lockstep base-2 round; the survivors of that (mostly primes) are grouped
+// again and run through the remaining bases in lockstep.
+inline void is_prime_batch(const uint64_t* n, bool* prime, size_t count) {
+    constexpr int L = kPrimalityLanes;
+    struct LaneGroup {
+        uint64_t n[L];
+        size_t index[L];
+        int filled = 0;
+
+        // Pads a partial group with a known prime so every lane does valid work
+        void pad() {
+            for (int l = filled; l < L; l++) n[l] = 65537;
+        }
+    };
+    LaneGroup candidates, probable;
+
+    auto flush_probable = [&]() {
+        probable.pad();
+        bool all[L], passed[L];
+        std::fill(all, all + L, true);
+        for (int i = 1; i < 7; i++) {
+            strong_probable_prime_lanes(probable.n, kMillerRabinBases[i], passed);
+            for (int l = 0; l < L; l++) all[l] = all[l] && passed[l];
+        }
+        for (int l = 0; l < probable.filled; l++) prime[probable.index[l]] = all[l];
+        probable.filled = 0;
+    };
+
+    auto flush_candidates = [&]() {
+        candidates.pad();
+        bool passed[L];
+        strong_probable_prime_lanes(candidates.n, kMillerRabinBases[0], passed);
+        for (int l = 0; l < candidates.filled; l++) {
+            if (!passed[l]) {
+                prime[candidates.index[l]] = false;
+                continue;
+            }
+            probable.n[probable.filled] = candidates.n[l];
+            probable.index[probable.filled] = candidates.index[l];
+            if (++probable.filled == L) flush_probable();
+        }
+        candidates.filled = 0;
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        int small = trial_divide_small(n[i]);
+        if (small >= 0) {
+            prime[i] = small == 1;
+            continue;
+        }
+        candidates.n[candidates.filled] = n[i];
+        candidates.index[candidates.filled] = i;
+        if (++candidates.filled == L) flush_candidates();
+    }
+    if (candidates.filled > 0) flush_candidates();
+    if (probable.filled > 0) flush_probable();
+}
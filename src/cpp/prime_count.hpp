@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "segmented_sieve.hpp"
+
+// Prime counting, pi(x), without listing the primes.
+//
+// prime_pi_sieve() popcounts segmented sieve blocks, splitting [0, x] across threads: O(x)
+// work but only a block of memory per thread. prime_pi_meissel() is the Meissel–Lehmer
+// method, pi(x) = phi(x, a) + a - 1 - P2(x, a) with a = pi(x^1/3), which only sieves up to
+// x^2/3; the top level of the phi recursion and the P2 sum are shared out across threads.
+
+inline uint64_t prime_pi_sieve(uint64_t x, unsigned num_threads,
+                               size_t block_bytes = kSieveBlockBytes) {
+    std::vector<uint32_t> primes = base_primes(static_cast<uint32_t>(isqrt(x)));
+    num_threads = std::max(1u, num_threads);
+    uint64_t total = x + 1;
+    std::vector<std::future<uint64_t>> futures;
+    for (unsigned t = 0; t < num_threads; t++) {
+        uint64_t lo = total / num_threads * t + std::min<uint64_t>(t, total % num_threads);
+        uint64_t hi = lo + total / num_threads + (t < total % num_threads ? 1 : 0);
+        futures.push_back(std::async(std::launch::async, [&primes, lo, hi, block_bytes]() {
+            return count_primes(lo, hi, primes, block_bytes);
+        }));
+    }
+    uint64_t count = 0;
+    for (auto& future : futures) {
+        count += future.get();
+    }
+    return count;
+}
+
+// pi(n) for every n <= limit in about limit/16 bytes: a bit per odd number plus a running
+// count per 64-bit word
+class PrimePiTable {
+public:
+    PrimePiTable(uint64_t limit, unsigned num_threads) : limit_(limit) {
+        size_t words = (limit / 2) / 64 + 1;
+        bits_.assign(words, 0);
+        std::vector<uint32_t> primes = base_primes(static_cast<uint32_t>(isqrt(limit)));
+
+        // Each thread sieves whole words: word w covers the odd numbers in [128w, 128w + 128)
+        num_threads = std::max(1u, std::min<unsigned>(num_threads, words));
+        size_t words_per_thread = (words + num_threads - 1) / num_threads;
+        std::vector<std::future<void>> futures;
+        for (size_t first_word = 0; first_word < words; first_word += words_per_thread) {
+            uint64_t lo = first_word * 128;
+            uint64_t hi = std::min(limit + 1, (first_word + words_per_thread) * 128);
+            futures.push_back(std::async(std::launch::async, [this, &primes, lo, hi]() {
+                sieve_segments(lo, hi, primes, kSieveBlockBytes,
+                               [this](uint64_t first, const uint64_t* block, uint64_t bits) {
+                    std::copy(block, block + (bits + 63) / 64, bits_.begin() + first / 128);
+                });
+            }));
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+
+        counts_.resize(words);
+        uint32_t running = 0;
+        for (size_t w = 0; w < words; w++) {
+            counts_[w] = running;
+            running += __builtin_popcountll(bits_[w]);
+        }
+    }
+
+    uint64_t limit() const { return limit_; }
+
+    // pi(n) for n <= limit()
+    uint64_t operator()(uint64_t n) const {
+        if (n < 2) return 0;
+        uint64_t last = (n - 1) / 2; // bit of the largest odd number <= n
+        uint64_t word = bits_[last / 64] & (~uint64_t(0) >> (63 - last % 64));
+        return 1 + counts_[last / 64] + __builtin_popcountll(word);
+    }
+
+private:
+    uint64_t limit_;
+    std::vector<uint64_t> bits_;
+    std::vector<uint32_t> counts_;
+};
+
+// Legendre's phi(x, a): the numbers in [1, x] with no prime factor among the first a primes
+class MeisselLehmer {
+public:
+    MeisselLehmer(const PrimePiTable& pi, const std::vector<uint32_t>& primes)
+        : pi_(pi), primes_(primes) {
+        // phi(r, k) for r below the primorial of the first k primes, k <= kTableLevels
+        uint32_t period = 1;
+        for (size_t k = 1; k <= kTableLevels && k <= primes_.size(); k++) {
+            uint32_t p = primes_[k - 1];
+            period *= p;
+            std::vector<uint32_t> table(period);
+            uint32_t count = 0;
+            for (uint32_t r = 0; r < period; r++) {
+                bool coprime = r > 0;
+                for (size_t j = 0; j < k && coprime; j++) coprime = r % primes_[j] != 0;
+                count += coprime;
+                table[r] = count;
+            }
+            periods_.push_back(period);
+            tables_.push_back(std::move(table));
+        }
+    }
+
+    uint64_t phi(uint64_t x, size_t a) const {
+        if (a == 0 || x == 0) return x;
+        if (a <= tables_.size()) {
+            uint64_t period = periods_[a - 1];
+            return x / period * tables_[a - 1].back() + tables_[a - 1][x % period];
+        }
+        // Below p_{a+1}^2 the only survivors are 1 and the primes in (p_a, x]
+        if (x <= pi_.limit() && a < primes_.size() &&
+            x < uint64_t(primes_[a]) * primes_[a]) {
+            uint64_t count = pi_(x);
+            return count > a ? count - a + 1 : 1;
+        }
+        // phi(x, a) = phi(x, c) - sum over c < i <= a of phi(x / p_i, i - 1)
+        size_t c = tables_.size();
+        uint64_t result = phi(x, c);
+        for (size_t i = c + 1; i <= a; i++) {
+            result -= phi(x / primes_[i - 1], i - 1);
+        }
+        return result;
+    }
+
+    static constexpr size_t kTableLevels = 6; // primorial 30030
+
+private:
+    const PrimePiTable& pi_;
+    const std::vector<uint32_t>& primes_;
+    std::vector<uint32_t> periods_;
+    std::vector<std::vector<uint32_t>> tables_;
+};
+
+// Calls fn(i) for i in [first, last) across num_threads threads and sums the results. Terms
+// are handed out one at a time from a shared counter since their costs vary widely.
+template <typename Fn>
+int64_t parallel_sum(size_t first, size_t last, unsigned num_threads, Fn fn) {
+    std::atomic<size_t> next{first};
+    auto worker = [&]() {
+        int64_t sum = 0;
+        for (size_t i = next++; i < last; i = next++) {
+            sum += fn(i);
+        }
+        return sum;
+    };
+    std::vector<std::future<int64_t>> futures;
+    for (unsigned t = 1; t < num_threads; t++) {
+        futures.push_back(std::async(std::launch::async, worker));
+    }
+    int64_t sum = worker();
+    for (auto& future : futures) {
+        sum += future.get();
+    }
+    return sum;
+}
+
+inline uint64_t prime_pi_meissel(uint64_t x, unsigned num_threads) {
+    num_threads = std::max(1u, num_threads);
+    uint64_t cbrt_x = static_cast<uint64_t>(std::cbrt(static_cast<double>(x)));
+    while (cbrt_x * cbrt_x * cbrt_x > x) cbrt_x--;
+    while ((cbrt_x + 1) * (cbrt_x + 1) * (cbrt_x + 1) <= x) cbrt_x++;
+
+    // pi is needed up to x / p for p > x^1/3, i.e. up to x^2/3
+    uint64_t table_limit = std::max<uint64_t>({x / std::max<uint64_t>(cbrt_x, 1), isqrt(x), 100});
+    PrimePiTable pi(std::min(x, table_limit), num_threads);
+    if (x <= pi.limit()) return pi(x);
+
+    std::vector<uint32_t> primes = base_primes(static_cast<uint32_t>(isqrt(x)));
+    size_t a = pi(cbrt_x);
+    size_t b = primes.size();
+    MeisselLehmer meissel(pi, primes);
+
+    // phi(x, a), top level split across threads
+    size_t c = std::min(a, MeisselLehmer::kTableLevels);
+    int64_t phi = meissel.phi(x, c) - parallel_sum(c + 1, a + 1, num_threads, [&](size_t i) {
+        return static_cast<int64_t>(meissel.phi(x / primes[i - 1], i - 1));
+    });
+
+    // P2(x, a): numbers <= x with exactly two prime factors, both greater than p_a
+    int64_t p2 = parallel_sum(a + 1, b + 1, num_threads, [&](size_t i) {
+        return static_cast<int64_t>(pi(x / primes[i - 1])) - static_cast<int64_t>(i - 1);
+    });
+
+    return static_cast<uint64_t>(phi + static_cast<int64_t>(a) - 1 - p2);
+}
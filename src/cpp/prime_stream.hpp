@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "segmented_sieve.hpp"
+
+// Streams the primes up to a limit to a consumer while later ones are still being sieved.
+//
+// The range is cut into fixed blocks that workers claim in ascending order from a shared
+// counter. Each block has its own slot in an append-only buffer: the worker that claimed it
+// fills in the primes and publishes them with a release store of the slot's ready flag. The
+// single consumer walks the slots in order, so it sees the primes in ascending order without
+// any locks, and no slot is ever written twice.
+
+constexpr uint64_t kPrimeStreamBlock = uint64_t(1) << 18; // numbers per block
+
+struct PrimeStreamSlot {
+    std::atomic<bool> ready{false};
+    std::vector<uint64_t> primes;
+};
+
+// Calls consume(primes) with each block's primes in [0, limit], in ascending order, on the
+// calling thread while num_threads workers sieve ahead. A slot is freed once consumed. With
+// `stream` false the consumer only starts once every block is done, i.e. collect first and
+// then process, for comparison.
+template <typename Fn>
+void stream_primes(uint64_t limit, unsigned num_threads, bool stream, Fn&& consume,
+                   uint64_t block = kPrimeStreamBlock) {
+    uint64_t end = limit + 1;
+    size_t blocks = (end + block - 1) / block;
+    std::vector<uint32_t> primes = base_primes(static_cast<uint32_t>(isqrt(limit)));
+    std::vector<PrimeStreamSlot> slots(blocks);
+    std::atomic<size_t> next{0};
+
+    // One bit per odd number, so a block fits in a single sieve segment
+    size_t sieve_bytes = static_cast<size_t>(block / 16 + 8);
+    auto worker = [&]() {
+        for (size_t b = next++; b < blocks; b = next++) {
+            uint64_t lo = b * block;
+            uint64_t hi = std::min(end, lo + block);
+            PrimeStreamSlot& slot = slots[b];
+            for_each_prime(lo, hi, primes, [&slot](uint64_t p) { slot.primes.push_back(p); },
+                           sieve_bytes);
+            slot.ready.store(true, std::memory_order_release);
+        }
+    };
+    std::vector<std::future<void>> futures;
+    for (unsigned t = 0; t < std::max(1u, num_threads); t++) {
+        futures.push_back(std::async(std::launch::async, worker));
+    }
+    if (!stream) {
+        for (auto& future : futures) {
+            future.wait();
+        }
+    }
+
+    for (PrimeStreamSlot& slot : slots) {
+        while (!slot.ready.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        consume(static_cast<const std::vector<uint64_t>&>(slot.primes));
+        std::vector<uint64_t>().swap(slot.primes);
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free ring buffers for passing work between threads.
+//
+// SpscRing has one producer and one consumer, each owning one index. MpmcRing allows any number
+// of each: every cell carries a sequence number that says whether it is free for the producer
+// of that lap or full for its consumer (Vyukov's bounded MPMC queue). try_push() and try_pop()
+// never block. push() and pop() yield until they succeed, so a full ring holds its producers
+// back (back-pressure). Capacities are rounded up to a power of two.
+
+constexpr size_t kCacheLine = 64;
+
+inline size_t ring_capacity(size_t requested) {
+    size_t capacity = 2;
+    while (capacity < requested) capacity *= 2;
+    return capacity;
+}
+
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : slots_(ring_capacity(capacity)), mask_(slots_.size() - 1) {}
+
+    bool try_push(T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size()) return false;
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(T value) {
+        while (!try_push(value)) std::this_thread::yield();
+    }
+
+    T pop() {
+        T value;
+        while (!try_pop(value)) std::this_thread::yield();
+        return value;
+    }
+
+    size_t capacity() const { return slots_.size(); }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_;
+    alignas(kCacheLine) std::atomic<size_t> head_{0};
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};
+};
+
+template <typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(size_t capacity)
+        : cells_(ring_capacity(capacity)), mask_(cells_.size() - 1) {
+        for (size_t i = 0; i < cells_.size(); i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(T& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+            if (diff == 0) {
+                // Free for this lap: claim it, then fill it and hand it to the consumers
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // still full from the previous lap
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& value) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(pos + cells_.size(), std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void push(T value) {
+        while (!try_push(value)) std::this_thread::yield();
+    }
+
+    T pop() {
+        T value;
+        while (!try_pop(value)) std::this_thread::yield();
+        return value;
+    }
+
+    size_t capacity() const { return cells_.size(); }
+
+private:
+    struct alignas(kCacheLine) Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::vector<Cell> cells_;
+    size_t mask_;
+    alignas(kCacheLine) std::atomic<size_t> head_{0};
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};
+};
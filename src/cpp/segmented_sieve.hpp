@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Segmented sieve of Eratosthenes over 64-bit ranges.
+//
+// A range [lo, hi) is sieved in blocks of `block_bytes` (sized to fit in cache) holding one
+// bit per odd number, using base primes up to sqrt(hi). Each sieving prime remembers where
+// it left off, so memory use is one block plus the base primes however large the range is.
+
+// Default block: 256 KB, i.e. 4M numbers per block, sized for a per-core L2 cache
+constexpr size_t kSieveBlockBytes = size_t(256) << 10;
+
+// floor(sqrt(n)), exact for all 64-bit n
+inline uint64_t isqrt(uint64_t n) {
+    uint64_t r = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+    while (r > UINT32_MAX || r * r > n) r--;
+    while (r < UINT32_MAX && (r + 1) * (r + 1) <= n) r++;
+    return r;
+}
+
+// All primes <= limit, by a plain sieve (limit is at most sqrt of the sieved range)
+inline std::vector<uint32_t> base_primes(uint32_t limit) {
+    std::vector<uint32_t> primes;
+    if (limit < 2) return primes;
+    std::vector<uint8_t> composite(limit + 1, 0);
+    for (uint64_t i = 2; i <= limit; i++) {
+        if (composite[i]) continue;
+        primes.push_back(static_cast<uint32_t>(i));
+        for (uint64_t j = i * i; j <= limit; j += i) {
+            composite[j] = 1;
+        }
+    }
+    return primes;
+}
+
+// Sieves the odd numbers in [lo, hi) and calls block(first, words, bits) for each block:
+// bit i of `words` (i < bits) is set iff first + 2i is prime. `primes` must contain every
+// prime up to sqrt(hi - 1); 2 is never reported.
+template <typename Fn>
+void sieve_segments(uint64_t lo, uint64_t hi, const std::vector<uint32_t>& primes,
+                    size_t block_bytes, Fn&& block) {
+    uint64_t first = lo | 1;
+    if (first >= hi) return;
+    uint64_t total_bits = (hi - first + 1) / 2;
+
+    // Bit index (relative to `first`) of the next odd multiple to cross off, per prime
+    std::vector<uint32_t> sieving;
+    std::vector<uint64_t> next;
+    for (uint32_t p : primes) {
+        if (p == 2) continue;
+        uint64_t square = uint64_t(p) * p;
+        if (square >= hi) break;
+        uint64_t start = std::max(square, (first + p - 1) / p * p);
+        if (start % 2 == 0) start += p;
+        sieving.push_back(p);
+        next.push_back((start - first) / 2);
+    }
+
+    uint64_t block_bits = std::max<size_t>(block_bytes, 8) / 8 * 64;
+    std::vector<uint64_t> words(block_bits / 64);
+    for (uint64_t begin = 0; begin < total_bits; begin += block_bits) {
+        uint64_t bits = std::min(block_bits, total_bits - begin);
+        size_t used_words = (bits + 63) / 64;
+        std::fill(words.begin(), words.begin() + used_words, ~uint64_t(0));
+        if (bits % 64) words[used_words - 1] = (uint64_t(1) << (bits % 64)) - 1;
+
+        for (size_t i = 0; i < sieving.size(); i++) {
+            uint64_t j = next[i] - begin;
+            uint64_t p = sieving[i];
+            for (; j < bits; j += p) {
+                words[j / 64] &= ~(uint64_t(1) << (j % 64));
+            }
+            next[i] = j + begin;
+        }
+        if (begin == 0 && first == 1) words[0] &= ~uint64_t(1); // 1 is not prime
+
+        block(first + 2 * begin, words.data(), bits);
+    }
+}
+
+// Number of primes in [lo, hi), counted with popcount without listing them
+inline uint64_t count_primes(uint64_t lo, uint64_t hi, const std::vector<uint32_t>& primes,
+                             size_t block_bytes = kSieveBlockBytes) {
+    uint64_t count = (lo <= 2 && hi > 2) ? 1 : 0;
+    auto count_block = [&count](uint64_t, const uint64_t* words, uint64_t bits) {
+        for (size_t w = 0; w < (bits + 63) / 64; w++) {
+            count += __builtin_popcountll(words[w]);
+        }
+    };
+    sieve_segments(lo, hi, primes, block_bytes, count_block);
+    return count;
+}
+
+// Calls fn(p) for every prime p in [lo, hi) in ascending order
+template <typename Fn>
+void for_each_prime(uint64_t lo, uint64_t hi, const std::vector<uint32_t>& primes, Fn&& fn,
+                    size_t block_bytes = kSieveBlockBytes) {
+    if (lo <= 2 && hi > 2) fn(uint64_t(2));
+    auto list_block = [&fn](uint64_t first, const uint64_t* words, uint64_t bits) {
+        for (size_t w = 0; w < (bits + 63) / 64; w++) {
+            for (uint64_t set = words[w]; set != 0; set &= set - 1) {
+                fn(first + 2 * (w * 64 + __builtin_ctzll(set)));
+            }
+        }
+    };
+    sieve_segments(lo, hi, primes, block_bytes, list_block);
+}
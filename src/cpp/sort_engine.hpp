@@ -0,0 +1,446 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "task_runtime.hpp"
+
+// Generic sort engine shared by the C++ benchmarks.
+//
+// The quicksort kernels work on any random access range with any strict weak ordering and
+// use iterator arithmetic throughout, so sizes above 2^31 are fine. sort_keys() picks an
+// LSD radix sort at compile time for arithmetic keys in ascending order and falls back to
+// the parallel quicksort for everything else (records, custom comparators).
+// merge_sort_parallel() is the stable alternative with an O(n log n) worst case.
+
+// Lomuto partition around the last element; returns the pivot's final position
+template <typename RandomIt, typename Compare>
+RandomIt partition_last(RandomIt first, RandomIt last, Compare comp) {
+    RandomIt pivot = last - 1;
+    RandomIt store = first;
+    for (RandomIt j = first; j != pivot; ++j) {
+        if (!comp(*pivot, *j)) {
+            std::iter_swap(store, j);
+            ++store;
+        }
+    }
+    std::iter_swap(store, pivot);
+    return store;
+}
+
+// Stable insertion sort for short ranges and merge sort leaves
+template <typename RandomIt, typename Compare>
+void insertion_sort(RandomIt first, RandomIt last, Compare comp) {
+    if (last - first < 2) return;
+    for (RandomIt i = first + 1; i != last; ++i) {
+        auto value = std::move(*i);
+        RandomIt j = i;
+        for (; j != first && comp(value, *(j - 1)); --j) {
+            *j = std::move(*(j - 1));
+        }
+        *j = std::move(value);
+    }
+}
+
+// Moves the median of a, b and c to c
+template <typename RandomIt, typename Compare>
+void median_to_last(RandomIt a, RandomIt b, RandomIt c, Compare comp) {
+    if (comp(*b, *a)) std::iter_swap(a, b);
+    if (comp(*c, *b)) std::iter_swap(b, c);
+    if (comp(*b, *a)) std::iter_swap(a, b);
+    std::iter_swap(b, c);
+}
+
+// Puts a median of 3 (a median of medians of 3 for large ranges) at last - 1, so that
+// partition_last pivots on it and sorted or reversed input splits evenly
+template <typename RandomIt, typename Compare>
+void choose_pivot(RandomIt first, RandomIt last, Compare comp) {
+    auto n = last - first;
+    RandomIt mid = first + n / 2;
+    if (n > 128) {
+        auto step = n / 8;
+        median_to_last(first, first + step, first + 2 * step, comp);
+        median_to_last(mid - step, mid + step, mid, comp);
+        median_to_last(last - 1 - 2 * step, last - 1 - step, last - 1, comp);
+        median_to_last(first + 2 * step, mid, last - 1, comp);
+    } else {
+        median_to_last(first, mid, last - 1, comp);
+    }
+}
+
+// Introsort loop for quicksort_serial; `lower_bound_known` says *(first - 1) is a lower bound
+// of the range (an earlier pivot)
+template <typename RandomIt, typename Compare>
+void introsort_loop(RandomIt first, RandomIt last, Compare comp, int depth_limit,
+                    bool lower_bound_known) {
+    constexpr std::ptrdiff_t insertion_cutoff = 16;
+    while (last - first > insertion_cutoff) {
+        // Already sorted or reversed ranges cost one scan; random input stops within a few
+        // elements
+        if (std::is_sorted(first, last, comp)) return;
+        auto descending = [&comp](const auto& a, const auto& b) { return comp(b, a); };
+        if (std::is_sorted(first, last, descending)) {
+            std::reverse(first, last);
+            return;
+        }
+
+        // Fall back to heapsort once the depth shows partitioning is not converging
+        if (depth_limit-- == 0) {
+            std::make_heap(first, last, comp);
+            std::sort_heap(first, last, comp);
+            return;
+        }
+
+        choose_pivot(first, last, comp);
+
+        // A pivot equal to the lower bound means many equal keys: put every key equal to it
+        // first and drop them, since they are already in their final place
+        if (lower_bound_known && !comp(*(first - 1), *(last - 1))) {
+            const auto& bound = *(first - 1);
+            first = std::partition(first, last, [&](const auto& x) { return !comp(bound, x); });
+            continue;
+        }
+
+        RandomIt pi = partition_last(first, last, comp);
+        auto left = pi - first;
+        auto right = last - (pi + 1);
+
+        // Badly unbalanced split: break up any pattern before the next round
+        auto n = last - first;
+        if (std::min(left, right) < n / 8) {
+            if (left > insertion_cutoff) {
+                std::iter_swap(first, first + left / 4);
+                std::iter_swap(pi - 1, pi - left / 4);
+            }
+            if (right > insertion_cutoff) {
+                std::iter_swap(pi + 1, pi + 1 + right / 4);
+                std::iter_swap(last - 1, last - right / 4);
+            }
+        }
+
+        // Recurse into the smaller side and loop on the larger one: O(log n) stack
+        if (left < right) {
+            introsort_loop(first, pi, comp, depth_limit, lower_bound_known);
+            first = pi + 1;
+            lower_bound_known = true;
+        } else {
+            introsort_loop(pi + 1, last, comp, depth_limit, true);
+            last = pi;
+        }
+    }
+    insertion_sort(first, last, comp);
+}
+
+// Introsort: quicksort with median-of-3 pivots that falls back to heapsort below
+// 2 * log2(n) levels, so adversarial inputs cost O(n log n) time and O(log n) stack
+template <typename RandomIt, typename Compare = std::less<>>
+void quicksort_serial(RandomIt first, RandomIt last, Compare comp = Compare()) {
+    auto n = last - first;
+    if (n < 2) return;
+    int depth_limit = 0;
+    for (auto i = n; i > 1; i >>= 1) depth_limit++;
+    introsort_loop(first, last, comp, 2 * depth_limit, false);
+}
+
+template <typename RandomIt, typename Compare = std::less<>>
+void quicksort_parallel(RandomIt first, RandomIt last, Compare comp = Compare(), int depth = 0) {
+    if (last - first > 1) {
+        if (depth >= 3) { // Limit parallel recursion depth
+            quicksort_serial(first, last, comp);
+            return;
+        }
+
+        choose_pivot(first, last, comp);
+        RandomIt pi = partition_last(first, last, comp);
+
+        std::future<void> left_sort = std::async(std::launch::async,
+            [first, pi, comp, depth]() {
+                quicksort_parallel(first, pi, comp, depth + 1);
+            });
+
+        quicksort_parallel(pi + 1, last, comp, depth + 1);
+        left_sort.wait();
+    }
+}
+
+#ifdef _OPENMP
+// OpenMP tasking version of quicksort_parallel: both sides become tasks, and final() turns
+// small or deep subranges into undeferred tasks that finish with the serial introsort
+template <typename RandomIt, typename Compare>
+void quicksort_openmp_task(RandomIt first, RandomIt last, Compare comp, int depth_limit) {
+    constexpr std::ptrdiff_t task_cutoff = 16384;
+    if (omp_in_final() || last - first <= task_cutoff || depth_limit == 0) {
+        quicksort_serial(first, last, comp);
+        return;
+    }
+
+    choose_pivot(first, last, comp);
+    RandomIt pi = partition_last(first, last, comp);
+
+    #pragma omp task final(pi - first <= task_cutoff)
+    quicksort_openmp_task(first, pi, comp, depth_limit - 1);
+    #pragma omp task final(last - pi - 1 <= task_cutoff)
+    quicksort_openmp_task(pi + 1, last, comp, depth_limit - 1);
+    #pragma omp taskwait
+}
+
+// Uses the team size set by omp_set_num_threads() (cpp_test sets it from the thread count)
+template <typename RandomIt, typename Compare = std::less<>>
+void quicksort_openmp(RandomIt first, RandomIt last, Compare comp = Compare()) {
+    int depth_limit = 0;
+    for (auto n = last - first; n > 1; n /= 2) depth_limit += 2;
+
+    #pragma omp parallel
+    #pragma omp single nowait
+    quicksort_openmp_task(first, last, comp, depth_limit);
+}
+#endif
+
+// Stable merge of [a, a_last) and [b, b_last) into out. Large merges are split in two
+// independent halves: the middle element of the longer run and its lower (or upper) bound in
+// the shorter run, which keeps equal keys from the first run ahead of the second.
+template <typename InIt, typename OutIt, typename Compare>
+void merge_parallel(InIt a, InIt a_last, InIt b, InIt b_last, OutIt out, Compare comp,
+                    int depth = 0) {
+    constexpr std::ptrdiff_t serial_cutoff = 8192;
+    if (depth >= 3 || (a_last - a) + (b_last - b) <= serial_cutoff) {
+        std::merge(std::make_move_iterator(a), std::make_move_iterator(a_last),
+                   std::make_move_iterator(b), std::make_move_iterator(b_last), out, comp);
+        return;
+    }
+
+    InIt a_mid, b_mid;
+    if (a_last - a >= b_last - b) {
+        a_mid = a + (a_last - a) / 2;
+        b_mid = std::lower_bound(b, b_last, *a_mid, comp);
+    } else {
+        b_mid = b + (b_last - b) / 2;
+        a_mid = std::upper_bound(a, a_last, *b_mid, comp);
+    }
+    OutIt out_mid = out + (a_mid - a) + (b_mid - b);
+
+    std::future<void> left = std::async(std::launch::async, [=]() {
+        merge_parallel(a, a_mid, b, b_mid, out, comp, depth + 1);
+    });
+    merge_parallel(a_mid, a_last, b_mid, b_last, out_mid, comp, depth + 1);
+    left.wait();
+}
+
+// Sorts [src, src + n) using [buf, buf + n) as the other half of a ping-pong pair; the
+// result ends up in buf when `into_buf` is set, in src otherwise. Each level merges from one
+// array into the other, so no memory is allocated below the top level.
+template <typename T, typename Compare>
+void merge_sort_ping_pong(T* src, T* buf, std::ptrdiff_t n, bool into_buf, Compare comp,
+                          int depth) {
+    constexpr std::ptrdiff_t leaf_size = 32;
+    if (n <= leaf_size) {
+        insertion_sort(src, src + n, comp);
+        if (into_buf) std::move(src, src + n, buf);
+        return;
+    }
+
+    // Sort both halves into the opposite array, then merge them back into the target
+    std::ptrdiff_t mid = n / 2;
+    if (depth < 3) {
+        std::future<void> left = std::async(std::launch::async, [=]() {
+            merge_sort_ping_pong(src, buf, mid, !into_buf, comp, depth + 1);
+        });
+        merge_sort_ping_pong(src + mid, buf + mid, n - mid, !into_buf, comp, depth + 1);
+        left.wait();
+    } else {
+        merge_sort_ping_pong(src, buf, mid, !into_buf, comp, depth + 1);
+        merge_sort_ping_pong(src + mid, buf + mid, n - mid, !into_buf, comp, depth + 1);
+    }
+    T* from = into_buf ? src : buf;
+    T* to = into_buf ? buf : src;
+    merge_parallel(from, from + mid, from + mid, from + n, to, comp, depth);
+}
+
+// Stable parallel merge sort for contiguous ranges, with one scratch buffer of n elements
+template <typename RandomIt, typename Compare = std::less<>>
+void merge_sort_parallel(RandomIt first, RandomIt last, Compare comp = Compare()) {
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    std::ptrdiff_t n = last - first;
+    if (n < 2) return;
+    std::vector<T> buffer(n);
+    merge_sort_ping_pong(&*first, buffer.data(), n, false, comp, 0);
+}
+
+#ifdef BENCH_COROUTINES
+// Coroutine versions of the parallel quicksort and merge sort on a TaskPool. A fork no longer
+// ties up a thread, so they split much further than the std::async depth limit of 3 and leave
+// the load balancing to work stealing.
+
+template <typename RandomIt, typename Compare>
+Task quicksort_task(RandomIt first, RandomIt last, Compare comp, int depth_limit) {
+    constexpr std::ptrdiff_t task_cutoff = 4096;
+    if (last - first <= task_cutoff || depth_limit == 0) {
+        quicksort_serial(first, last, comp);
+        co_return;
+    }
+    choose_pivot(first, last, comp);
+    RandomIt pi = partition_last(first, last, comp);
+    co_await spawn(quicksort_task(first, pi, comp, depth_limit - 1));
+    co_await spawn(quicksort_task(pi + 1, last, comp, depth_limit - 1));
+    co_await join();
+}
+
+template <typename RandomIt, typename Compare = std::less<>>
+void quicksort_coroutine(TaskPool& pool, RandomIt first, RandomIt last, Compare comp = Compare()) {
+    int depth_limit = 0;
+    for (auto n = last - first; n > 1; n /= 2) depth_limit += 2;
+    pool.run(quicksort_task(first, last, comp, depth_limit));
+}
+
+// merge_parallel() with both halves spawned as tasks
+template <typename InIt, typename OutIt, typename Compare>
+Task merge_task(InIt a, InIt a_last, InIt b, InIt b_last, OutIt out, Compare comp) {
+    constexpr std::ptrdiff_t task_cutoff = 8192;
+    if ((a_last - a) + (b_last - b) <= task_cutoff) {
+        std::merge(std::make_move_iterator(a), std::make_move_iterator(a_last),
+                   std::make_move_iterator(b), std::make_move_iterator(b_last), out, comp);
+        co_return;
+    }
+    InIt a_mid, b_mid;
+    if (a_last - a >= b_last - b) {
+        a_mid = a + (a_last - a) / 2;
+        b_mid = std::lower_bound(b, b_last, *a_mid, comp);
+    } else {
+        b_mid = b + (b_last - b) / 2;
+        a_mid = std::upper_bound(a, a_last, *b_mid, comp);
+    }
+    OutIt out_mid = out + (a_mid - a) + (b_mid - b);
+    co_await spawn(merge_task(a, a_mid, b, b_mid, out, comp));
+    co_await spawn(merge_task(a_mid, a_last, b_mid, b_last, out_mid, comp));
+    co_await join();
+}
+
+// merge_sort_ping_pong() as tasks; below the cutoff it runs that function serially (a depth
+// of 3 or more disables its std::async forks and parallel merges)
+template <typename T, typename Compare>
+Task merge_sort_task(T* src, T* buf, std::ptrdiff_t n, bool into_buf, Compare comp) {
+    constexpr std::ptrdiff_t task_cutoff = 4096;
+    if (n <= task_cutoff) {
+        merge_sort_ping_pong(src, buf, n, into_buf, comp, 3);
+        co_return;
+    }
+    std::ptrdiff_t mid = n / 2;
+    co_await spawn(merge_sort_task(src, buf, mid, !into_buf, comp));
+    co_await spawn(merge_sort_task(src + mid, buf + mid, n - mid, !into_buf, comp));
+    co_await join();
+    T* from = into_buf ? src : buf;
+    T* to = into_buf ? buf : src;
+    co_await spawn(merge_task(from, from + mid, from + mid, from + n, to, comp));
+    co_await join();
+}
+
+template <typename RandomIt, typename Compare = std::less<>>
+void merge_sort_coroutine(TaskPool& pool, RandomIt first, RandomIt last,
+                          Compare comp = Compare()) {
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    std::ptrdiff_t n = last - first;
+    if (n < 2) return;
+    std::vector<T> buffer(n);
+    pool.run(merge_sort_task(&*first, buffer.data(), n, false, comp));
+}
+#endif
+
+// Maps an arithmetic key to an unsigned integer with the same ordering
+template <typename T>
+auto radix_key(T value) {
+    static_assert(std::is_arithmetic_v<T>, "radix_key needs an arithmetic type");
+    if constexpr (std::is_floating_point_v<T>) {
+        using Bits = std::conditional_t<sizeof(T) == 8, uint64_t, uint32_t>;
+        constexpr Bits sign = Bits(1) << (sizeof(T) * 8 - 1);
+        Bits bits;
+        std::memcpy(&bits, &value, sizeof(T));
+        return (bits & sign) ? Bits(~bits) : Bits(bits | sign);
+    } else {
+        using Bits = std::make_unsigned_t<T>;
+        if constexpr (std::is_signed_v<T>) {
+            constexpr Bits sign = Bits(1) << (sizeof(T) * 8 - 1);
+            return Bits(static_cast<Bits>(value) ^ sign);
+        } else {
+            return Bits(value);
+        }
+    }
+}
+
+// LSD radix sort with 8-bit digits for arithmetic keys; digits on which every key agrees
+// are skipped, so narrow value ranges cost fewer passes. `buffer` is the scratch half of the
+// ping-pong pair: a caller that keeps it (with capacity for n keys) sorts without allocating.
+template <typename RandomIt>
+void radix_sort(RandomIt first, RandomIt last,
+                std::vector<typename std::iterator_traits<RandomIt>::value_type>& buffer) {
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    constexpr int passes = sizeof(T);
+    size_t n = last - first;
+    if (n < 2) return;
+
+    buffer.resize(n);
+    T* src = &*first;
+    T* dst = buffer.data();
+
+    std::array<size_t, passes * 256> counts{};
+    for (size_t i = 0; i < n; i++) {
+        auto key = radix_key(src[i]);
+        for (int p = 0; p < passes; p++) {
+            counts[p * 256 + ((key >> (8 * p)) & 0xFF)]++;
+        }
+    }
+
+    for (int p = 0; p < passes; p++) {
+        size_t* count = &counts[p * 256];
+        if (std::find(count, count + 256, n) != count + 256) continue;
+
+        size_t offset = 0;
+        for (int d = 0; d < 256; d++) {
+            size_t c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[count[(radix_key(src[i]) >> (8 * p)) & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != &*first) {
+        std::copy(src, src + n, first);
+    }
+}
+
+template <typename RandomIt>
+void radix_sort(RandomIt first, RandomIt last) {
+    std::vector<typename std::iterator_traits<RandomIt>::value_type> buffer;
+    radix_sort(first, last, buffer);
+}
+
+// True when sort_keys() can use the radix path for this element type and ordering
+template <typename T, typename Compare>
+constexpr bool use_radix_sort =
+    std::is_arithmetic_v<T> && !std::is_same_v<T, bool> &&
+    (std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::less<T>>);
+
+// Sorts [first, last) with the best kernel for the element type, selected at compile time
+template <typename RandomIt, typename Compare = std::less<>>
+void sort_keys(RandomIt first, RandomIt last, Compare comp = Compare()) {
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    if constexpr (use_radix_sort<T, Compare>) {
+        radix_sort(first, last);
+    } else {
+        quicksort_parallel(first, last, comp);
+    }
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "bench_rng.hpp"
+#include "ring_buffer.hpp"
+#include "sort_engine.hpp"
+
+// Generate -> sort -> merge -> verify as a streaming pipeline rather than one-shot phases.
+//
+// A generator thread produces blocks of random keys into an MPMC ring. Sorter threads take
+// blocks off it as they become free and pass each sorted block to the merger through a second
+// MPMC ring. The merger keeps runs in levels: as soon as a level holds `fan_in` runs, they are
+// k-way merged into one run of the next level, so most merging overlaps the sorting. Once the
+// input ends, a final k-way merge over the runs left on every level streams the fully sorted
+// keys to the verifier in blocks, over an SPSC ring. The verifier checks that the stream is in
+// order, across blocks too, and that the key count and sum match what was generated. The
+// rings are small, so a slow stage holds back the stages before it. All keys are held in
+// memory until the final merge.
+
+struct PipelineStats {
+    size_t keys = 0;
+    double seconds = 0;
+    // Fraction of the wall time each stage spent working rather than waiting on a ring; for
+    // the sorters, the mean over all of them
+    double generate_occupancy = 0;
+    double sort_occupancy = 0;
+    double merge_occupancy = 0;
+    double verify_occupancy = 0;
+    bool verified = false;
+};
+
+struct PipelineBlock {
+    std::vector<int> keys;
+    bool last = false; // end of stream marker, one per sorter
+};
+
+// K-way merges the sorted `runs`, handing their keys to out(key) in ascending order
+template <typename Out>
+void kway_merge(const std::vector<std::vector<int>>& runs, Out&& out) {
+    using Entry = std::pair<int, size_t>;
+    auto greater = [](const Entry& a, const Entry& b) { return b.first < a.first; };
+    std::priority_queue<Entry, std::vector<Entry>, decltype(greater)> heap(greater);
+    std::vector<size_t> next(runs.size(), 0);
+    for (size_t r = 0; r < runs.size(); r++) {
+        if (!runs[r].empty()) heap.emplace(runs[r][0], r);
+    }
+    while (!heap.empty()) {
+        size_t r = heap.top().second;
+        out(heap.top().first);
+        heap.pop();
+        if (++next[r] < runs[r].size()) heap.emplace(runs[r][next[r]], r);
+    }
+}
+
+inline PipelineStats run_sort_pipeline(size_t total_keys, size_t block_keys, size_t fan_in,
+                                       unsigned num_sorters, const CounterRng& rng,
+                                       size_t ring_slots = 16) {
+    using clock = std::chrono::high_resolution_clock;
+    auto seconds_since = [](clock::time_point start) {
+        return std::chrono::duration<double>(clock::now() - start).count();
+    };
+    block_keys = std::max<size_t>(1, block_keys);
+    fan_in = std::max<size_t>(2, fan_in);
+    num_sorters = std::max(1u, num_sorters);
+
+    MpmcRing<PipelineBlock> unsorted(ring_slots);
+    MpmcRing<PipelineBlock> sorted(ring_slots);
+    SpscRing<std::vector<int>> merged(ring_slots);
+    auto start = clock::now();
+
+    auto generate = std::async(std::launch::async, [&]() {
+        double busy = 0;
+        uint64_t sum = 0;
+        for (size_t first = 0; first < total_keys; first += block_keys) {
+            auto work_start = clock::now();
+            PipelineBlock block;
+            block.keys.resize(std::min(block_keys, total_keys - first));
+            fill_uniform_int(block.keys.data(), block.keys.size(), first, rng, 1, 1000000, 1);
+            for (int key : block.keys) sum += key;
+            busy += seconds_since(work_start);
+            unsorted.push(std::move(block));
+        }
+        for (unsigned s = 0; s < num_sorters; s++) {
+            unsorted.push(PipelineBlock{{}, true});
+        }
+        return std::make_pair(busy, sum);
+    });
+
+    std::vector<std::future<double>> sorters;
+    for (unsigned s = 0; s < num_sorters; s++) {
+        sorters.push_back(std::async(std::launch::async, [&]() {
+            double busy = 0;
+            while (true) {
+                PipelineBlock block = unsorted.pop();
+                if (block.last) {
+                    sorted.push(std::move(block));
+                    return busy;
+                }
+                auto work_start = clock::now();
+                sort_keys(block.keys.begin(), block.keys.end());
+                busy += seconds_since(work_start);
+                sorted.push(std::move(block));
+            }
+        }));
+    }
+
+    auto merge = std::async(std::launch::async, [&]() {
+        double busy = 0;
+        // levels[l] holds runs of fan_in^l blocks
+        std::vector<std::vector<std::vector<int>>> levels;
+        unsigned finished = 0;
+        while (finished < num_sorters) {
+            PipelineBlock block = sorted.pop();
+            if (block.last) {
+                finished++;
+                continue;
+            }
+            auto work_start = clock::now();
+            std::vector<int> run = std::move(block.keys);
+            for (size_t level = 0;; level++) {
+                if (levels.size() == level) levels.emplace_back();
+                levels[level].push_back(std::move(run));
+                if (levels[level].size() < fan_in) break;
+                size_t run_size = 0;
+                for (const auto& keys : levels[level]) run_size += keys.size();
+                run = std::vector<int>();
+                run.reserve(run_size);
+                kway_merge(levels[level], [&run](int key) { run.push_back(key); });
+                levels[level].clear();
+            }
+            busy += seconds_since(work_start);
+        }
+
+        // Final merge of the runs left on every level, streamed out in blocks; time blocked on
+        // the ring does not count as work
+        auto work_start = clock::now();
+        double waiting = 0;
+        std::vector<std::vector<int>> rest;
+        for (auto& level : levels) {
+            for (auto& run : level) rest.push_back(std::move(run));
+        }
+        std::vector<int> out;
+        out.reserve(block_keys);
+        kway_merge(rest, [&](int key) {
+            out.push_back(key);
+            if (out.size() == block_keys) {
+                auto push_start = clock::now();
+                merged.push(std::move(out));
+                waiting += seconds_since(push_start);
+                out = std::vector<int>();
+                out.reserve(block_keys);
+            }
+        });
+        if (!out.empty()) merged.push(std::move(out));
+        busy += seconds_since(work_start) - waiting;
+        merged.push(std::vector<int>()); // end of stream
+        return busy;
+    });
+
+    double verify_busy = 0;
+    size_t verified_keys = 0;
+    uint64_t verified_sum = 0;
+    bool in_order = true;
+    int previous = std::numeric_limits<int>::min();
+    while (true) {
+        std::vector<int> block = merged.pop();
+        if (block.empty()) break;
+        auto work_start = clock::now();
+        in_order = in_order && previous <= block.front() &&
+                   std::is_sorted(block.begin(), block.end());
+        previous = block.back();
+        for (int key : block) verified_sum += key;
+        verified_keys += block.size();
+        verify_busy += seconds_since(work_start);
+    }
+
+    auto [generate_busy, generated_sum] = generate.get();
+    double sort_busy = 0;
+    for (auto& sorter : sorters) {
+        sort_busy += sorter.get();
+    }
+    double merge_busy = merge.get();
+
+    PipelineStats stats;
+    stats.keys = verified_keys;
+    stats.seconds = seconds_since(start);
+    stats.generate_occupancy = generate_busy / stats.seconds;
+    stats.sort_occupancy = sort_busy / num_sorters / stats.seconds;
+    stats.merge_occupancy = merge_busy / stats.seconds;
+    stats.verify_occupancy = verify_busy / stats.seconds;
+    stats.verified = in_order && verified_keys == total_keys && verified_sum == generated_sum;
+    return stats;
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+
+#include "sort_engine.hpp"
+
+// Kernels specialized at compile time.
+//
+// The lookup tables are built by constexpr functions, so the compiler evaluates them and they
+// ship in the binary's read-only data. There is no startup cost and nothing is shared between
+// threads at run time. The tables are the primes below 2^16 (as a bitmap and as a list), the
+// gaps of the 2·3·5·7 wheel, F(0) .. F(93) (the last Fibonacci number that fits in 64 bits) and
+// Batcher sorting networks for up to 32 elements. The network sorts are instantiated for every
+// size and element type: each is a fully unrolled sequence of branch-free compare-exchanges
+// with constant offsets. small_sort() picks one through a table of function pointers indexed
+// by size.
+
+constexpr uint32_t kStaticPrimeLimit = 1 << 16;
+
+// Sieve of Eratosthenes over [0, kStaticPrimeLimit)
+constexpr std::array<bool, kStaticPrimeLimit> make_prime_flags() {
+    std::array<bool, kStaticPrimeLimit> flags{};
+    for (uint32_t i = 2; i < kStaticPrimeLimit; i++) flags[i] = true;
+    for (uint32_t i = 2; i * i < kStaticPrimeLimit; i++) {
+        if (!flags[i]) continue;
+        for (uint32_t j = i * i; j < kStaticPrimeLimit; j += i) flags[j] = false;
+    }
+    return flags;
+}
+
+// One bit per odd number: word w holds the odd numbers in [128w, 128w + 128)
+constexpr std::array<uint64_t, kStaticPrimeLimit / 128> make_prime_bits() {
+    std::array<uint64_t, kStaticPrimeLimit / 128> bits{};
+    std::array<bool, kStaticPrimeLimit> flags = make_prime_flags();
+    for (uint32_t n = 3; n < kStaticPrimeLimit; n += 2) {
+        if (flags[n]) bits[n / 128] |= uint64_t(1) << (n / 2 % 64);
+    }
+    return bits;
+}
+
+constexpr size_t count_static_primes() {
+    std::array<bool, kStaticPrimeLimit> flags = make_prime_flags();
+    size_t count = 0;
+    for (bool prime : flags) count += prime;
+    return count;
+}
+
+inline constexpr size_t kStaticPrimeCount = count_static_primes();
+static_assert(kStaticPrimeCount == 6542, "pi(2^16) is 6542");
+
+constexpr std::array<uint32_t, kStaticPrimeCount> make_static_primes() {
+    std::array<uint32_t, kStaticPrimeCount> primes{};
+    std::array<bool, kStaticPrimeLimit> flags = make_prime_flags();
+    size_t count = 0;
+    for (uint32_t n = 2; n < kStaticPrimeLimit; n++) {
+        if (flags[n]) primes[count++] = n;
+    }
+    return primes;
+}
+
+inline constexpr std::array<uint64_t, kStaticPrimeLimit / 128> kStaticPrimeBits =
+    make_prime_bits();
+inline constexpr std::array<uint32_t, kStaticPrimeCount> kStaticPrimes = make_static_primes();
+
+// Gaps between the residues mod 210 coprime to 2, 3, 5 and 7, starting from 1: stepping
+// through them from 1 visits 1, 11, 13, 17, ... (48 candidates per 210 numbers)
+constexpr std::array<uint8_t, 48> make_wheel_gaps() {
+    std::array<uint8_t, 48> gaps{};
+    size_t count = 0;
+    uint32_t previous = 1;
+    for (uint32_t r = 2; r <= 211; r++) {
+        if (r % 2 && r % 3 && r % 5 && r % 7) {
+            gaps[count++] = static_cast<uint8_t>(r - previous);
+            previous = r;
+        }
+    }
+    return gaps;
+}
+
+inline constexpr std::array<uint8_t, 48> kWheel210Gaps = make_wheel_gaps();
+
+constexpr std::array<uint64_t, 94> make_fibonacci() {
+    std::array<uint64_t, 94> fib{};
+    fib[1] = 1;
+    for (size_t i = 2; i < fib.size(); i++) fib[i] = fib[i - 1] + fib[i - 2];
+    return fib;
+}
+
+inline constexpr std::array<uint64_t, 94> kFibonacci = make_fibonacci();
+static_assert(kFibonacci[93] == 12200160415121876738ULL, "F(93) is the largest 64-bit value");
+
+// F(n) mod 2^64 like fibonacci_dynamic(): a table lookup up to F(93), the recurrence after it
+inline uint64_t fibonacci_static(size_t n) {
+    if (n < kFibonacci.size()) return kFibonacci[n];
+    uint64_t a = kFibonacci[92], b = kFibonacci[93];
+    for (size_t i = kFibonacci.size(); i <= n; i++) {
+        uint64_t next = a + b;
+        a = b;
+        b = next;
+    }
+    return b;
+}
+
+// Primality of a 32-bit n: a bitmap lookup below 2^16, trial division by the table above it
+// (any composite n < 2^32 has a prime factor below 2^16)
+inline bool is_prime_static(uint32_t n) {
+    if (n < kStaticPrimeLimit) {
+        return n == 2 || (n % 2 == 1 && (kStaticPrimeBits[n / 128] >> (n / 2 % 64)) & 1);
+    }
+    for (uint32_t p : kStaticPrimes) {
+        if (uint64_t(p) * p > n) break;
+        if (n % p == 0) return false;
+    }
+    return true;
+}
+
+// Number of primes <= limit (limit < 2^32), testing only the numbers on the 210 wheel
+inline uint64_t count_primes_static(uint32_t limit) {
+    uint64_t count = 0;
+    for (uint32_t p : {2u, 3u, 5u, 7u}) count += p <= limit;
+    uint64_t n = 1;
+    for (size_t w = 0;; w = w + 1 == kWheel210Gaps.size() ? 0 : w + 1) {
+        n += kWheel210Gaps[w];
+        if (n > limit) break;
+        count += is_prime_static(static_cast<uint32_t>(n));
+    }
+    return count;
+}
+
+// Batcher's odd-even merge sort network for n inputs, as compare-exchanges (i, j) with i < j
+struct Comparator {
+    uint8_t i;
+    uint8_t j;
+};
+
+// Visits the network's comparators in order (the iterative form works for any n)
+template <typename Fn>
+constexpr void for_each_comparator(size_t n, Fn&& fn) {
+    for (size_t p = 1; p < n; p += p) {
+        for (size_t k = p; k >= 1; k /= 2) {
+            for (size_t j = k % p; j + k < n; j += k + k) {
+                for (size_t i = 0; i < k && i + j + k < n; i++) {
+                    if ((i + j) / (p + p) == (i + j + k) / (p + p)) fn(i + j, i + j + k);
+                }
+            }
+        }
+    }
+}
+
+template <size_t N>
+constexpr size_t network_size() {
+    size_t count = 0;
+    for_each_comparator(N, [&count](size_t, size_t) { count++; });
+    return count;
+}
+
+template <size_t N>
+constexpr std::array<Comparator, network_size<N>()> make_network() {
+    std::array<Comparator, network_size<N>()> network{};
+    size_t count = 0;
+    for_each_comparator(N, [&](size_t i, size_t j) {
+        network[count++] = Comparator{static_cast<uint8_t>(i), static_cast<uint8_t>(j)};
+    });
+    return network;
+}
+
+template <size_t N>
+inline constexpr auto kSortingNetwork = make_network<N>();
+
+constexpr size_t kMaxNetworkSize = 32;
+
+// Orders a and b without a branch: min/max instructions for floating point, one compare
+// feeding two conditional moves for integers (faster with GCC than std::min/max there)
+template <typename T>
+inline void compare_exchange(T& a, T& b) {
+    T x = a, y = b;
+    if constexpr (std::is_floating_point_v<T>) {
+        a = std::min(x, y);
+        b = std::max(x, y);
+    } else {
+        bool swap = y < x;
+        a = swap ? y : x;
+        b = swap ? x : y;
+    }
+}
+
+template <size_t N, typename T, size_t... K>
+inline void apply_network([[maybe_unused]] T* data, std::index_sequence<K...>) {
+    (compare_exchange(data[kSortingNetwork<N>[K].i], data[kSortingNetwork<N>[K].j]), ...);
+}
+
+// Sorts exactly N elements with the unrolled network
+template <typename T, size_t N>
+void network_sort(T* data) {
+    apply_network<N>(data, std::make_index_sequence<kSortingNetwork<N>.size()>{});
+}
+
+template <typename T, size_t... N>
+constexpr std::array<void (*)(T*), sizeof...(N)> make_sort_dispatch(std::index_sequence<N...>) {
+    return {&network_sort<T, N>...};
+}
+
+// network_sort<T, n> for n = 0 .. kMaxNetworkSize
+template <typename T>
+inline constexpr auto kSortDispatch =
+    make_sort_dispatch<T>(std::make_index_sequence<kMaxNetworkSize + 1>{});
+
+// Sorts n elements with the network for n inputs, or with quicksort_serial() beyond
+// kMaxNetworkSize
+template <typename T>
+void small_sort(T* data, size_t n) {
+    if (n <= kMaxNetworkSize) {
+        kSortDispatch<T>[n](data);
+    } else {
+        quicksort_serial(data, data + n);
+    }
+}
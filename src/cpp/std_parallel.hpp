@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+#include "primality.hpp"
+
+// The benchmark kernels written with the C++17 standard parallel algorithms, as a baseline for
+// the hand-written ones.
+//
+// libstdc++ runs std::execution policies on TBB, so the policy is only used when the build
+// defines BENCH_PARALLEL_STL and links -ltbb (run_benchmarks.sh tries that first). Otherwise
+// the same calls are made without a policy and run serially.
+
+#if defined(BENCH_PARALLEL_STL) && __has_include(<execution>)
+#include <execution>
+#define STD_PAR_POLICY std::execution::par_unseq,
+constexpr bool kStdParallel = true;
+#else
+#define STD_PAR_POLICY
+constexpr bool kStdParallel = false;
+#endif
+
+inline const char* std_parallel_backend() {
+    return kStdParallel ? "par_unseq" : "serial";
+}
+
+// F(k) and F(k + 1) as one scan element: combining the elements for a and b gives the one for
+// a + b (the product of the Fibonacci matrices M^a M^b), which is associative and wraps mod
+// 2^64 like the iterative loop
+struct FibonacciStep {
+    unsigned long long f, f1;
+};
+
+inline FibonacciStep combine_fibonacci(const FibonacciStep& x, const FibonacciStep& y) {
+    return {x.f * y.f1 + (x.f1 - x.f) * y.f, x.f1 * y.f1 + x.f * y.f};
+}
+
+// F(0) .. F(n - 1) by an exclusive scan of n copies of M over the identity M^0
+inline std::vector<unsigned long long> std_par_fibonacci(int n) {
+    std::vector<FibonacciStep> steps(std::max(n, 0), FibonacciStep{1, 1});
+    // Not in place: the TBB backend's exclusive scan gives wrong results when the output
+    // aliases the input
+    std::vector<FibonacciStep> powers(steps.size());
+    std::exclusive_scan(STD_PAR_POLICY steps.begin(), steps.end(), powers.begin(),
+                        FibonacciStep{0, 1}, combine_fibonacci);
+    std::vector<unsigned long long> result(powers.size());
+    std::transform(STD_PAR_POLICY powers.begin(), powers.end(), result.begin(),
+                   [](const FibonacciStep& step) { return step.f; });
+    return result;
+}
+
+// Number of primes <= limit. The standard library has no counting iterator, so the
+// candidates are materialized first.
+inline size_t std_par_count_primes(int limit) {
+    if (limit < 2) return 0;
+    std::vector<int> candidates(limit - 1);
+    std::iota(candidates.begin(), candidates.end(), 2);
+    return std::transform_reduce(STD_PAR_POLICY candidates.begin(), candidates.end(), size_t(0),
+                                 std::plus<>(), [](int n) -> size_t { return is_prime(n); });
+}
+
+template <typename RandomIt>
+void std_par_sort(RandomIt first, RandomIt last) {
+    std::sort(STD_PAR_POLICY first, last);
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+// Fork/join tasks as C++20 coroutines, run by a fixed pool of threads with continuation
+// stealing.
+//
+// `co_await spawn(child)` starts the child at once on the current thread and leaves the
+// parent's continuation at the bottom of this thread's deque. If no other worker steals it, the
+// child resumes the parent directly when it finishes. If one does, the parent continues on the
+// thief's thread in the meantime. `co_await join()` waits for every child spawned so far.
+// Neither blocks a thread: a worker whose continuation was stolen goes back to stealing, and a
+// task suspended in join is resumed by whichever worker finishes its last child. A fork
+// therefore costs a coroutine frame and a deque push rather than the thread std::async starts.
+//
+// Only compiled as C++20 (BENCH_COROUTINES is defined when it is).
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#define BENCH_COROUTINES 1
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Queue of runnable continuations for one worker: the owner pushes and pops at the back,
+// thieves take the oldest entry from the front
+class TaskDeque {
+public:
+    void push(std::coroutine_handle<> h) {
+        std::lock_guard<std::mutex> guard(lock_);
+        handles_.push_back(h);
+    }
+
+    std::coroutine_handle<> pop() {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (handles_.empty()) return nullptr;
+        std::coroutine_handle<> h = handles_.back();
+        handles_.pop_back();
+        return h;
+    }
+
+    // Pops h if it is still at the back, i.e. nobody stole it
+    bool pop_if(std::coroutine_handle<> h) {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (handles_.empty() || handles_.back() != h) return false;
+        handles_.pop_back();
+        return true;
+    }
+
+    std::coroutine_handle<> steal() {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (handles_.empty()) return nullptr;
+        std::coroutine_handle<> h = handles_.front();
+        handles_.pop_front();
+        return h;
+    }
+
+private:
+    std::mutex lock_;
+    std::deque<std::coroutine_handle<>> handles_;
+};
+
+// Deque of the pool worker running on this thread (null elsewhere)
+inline thread_local TaskDeque* t_task_deque = nullptr;
+
+class Task {
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    // Every task frees its own frame when it finishes, then hands the thread to the task that
+    // is waiting for it: the parent for a spawned task, TaskPool::run() for a root
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(Handle h) noexcept {
+            promise_type& promise = h.promise();
+            std::coroutine_handle<> parent = promise.parent;
+            std::atomic<long>* parent_pending = promise.parent_pending;
+            std::atomic<bool>* root_done = promise.root_done;
+            h.destroy();
+
+            if (root_done) {
+                root_done->store(true, std::memory_order_release);
+                root_done->notify_all();
+                return std::noop_coroutine();
+            }
+            long left = parent_pending->fetch_sub(1, std::memory_order_acq_rel) - 1;
+            // Not stolen: carry on with the parent on this thread
+            if (t_task_deque->pop_if(parent)) return parent;
+            // Stolen, and the parent is suspended in join() waiting for this last child
+            if (left == 0) return parent;
+            return std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    struct promise_type {
+        std::coroutine_handle<> parent;
+        std::atomic<long>* parent_pending = nullptr;
+        std::atomic<bool>* root_done = nullptr;
+        // Children still running, plus one held by the task itself until it joins
+        std::atomic<long> pending{1};
+
+        Task get_return_object() { return Task(Handle::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle_) handle_.destroy();
+    }
+
+    // Gives up ownership of a task that has been started; it will free itself
+    Handle release() { return std::exchange(handle_, nullptr); }
+
+private:
+    explicit Task(Handle h) : handle_(h) {}
+
+    Handle handle_;
+};
+
+struct SpawnAwaiter {
+    Task child;
+
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<> await_suspend(Task::Handle parent) noexcept {
+        Task::Handle h = child.release();
+        h.promise().parent = parent;
+        h.promise().parent_pending = &parent.promise().pending;
+        parent.promise().pending.fetch_add(1, std::memory_order_relaxed);
+        // From here on a thief may resume the parent, so neither it nor this awaiter (which
+        // lives in the parent's frame) may be touched
+        t_task_deque->push(parent);
+        return h;
+    }
+    void await_resume() noexcept {}
+};
+
+struct JoinAwaiter {
+    Task::promise_type* promise = nullptr;
+
+    bool await_ready() noexcept { return false; }
+    bool await_suspend(Task::Handle h) noexcept {
+        promise = &h.promise();
+        // Dropping the task's own reference; if children are still running the last one
+        // to finish resumes us
+        return promise->pending.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+    void await_resume() noexcept { promise->pending.store(1, std::memory_order_relaxed); }
+};
+
+// Starts `child` and makes the rest of the calling task available to other workers
+inline SpawnAwaiter spawn(Task child) {
+    return SpawnAwaiter{std::move(child)};
+}
+
+// Waits until every task spawned by the calling task has finished
+inline JoinAwaiter join() {
+    return {};
+}
+
+class TaskPool {
+public:
+    explicit TaskPool(unsigned num_threads) {
+        num_threads = std::max(1u, num_threads);
+        for (unsigned i = 0; i < num_threads; i++) {
+            deques_.push_back(std::make_unique<TaskDeque>());
+        }
+        for (unsigned i = 0; i < num_threads; i++) {
+            threads_.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+    // Runs `root` and everything it spawns on the pool, blocking the caller until it is done.
+    // One root at a time.
+    void run(Task root) {
+        Task::Handle h = root.release();
+        h.promise().root_done = &root_done_;
+        root_done_.store(false, std::memory_order_relaxed);
+        deques_[0]->push(h);
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock_);
+            running_.store(true, std::memory_order_relaxed);
+        }
+        wake_.notify_all();
+        root_done_.wait(false, std::memory_order_acquire);
+        running_.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    void worker_loop(unsigned index) {
+        t_task_deque = deques_[index].get();
+        std::minstd_rand rng(index + 1);
+        while (true) {
+            std::coroutine_handle<> h = t_task_deque->pop();
+            for (size_t attempt = 0; !h && attempt < deques_.size(); attempt++) {
+                h = deques_[rng() % deques_.size()]->steal();
+            }
+            if (h) {
+                h.resume();
+                continue;
+            }
+            // Out of work: spin (yielding) while a root is running, sleep otherwise
+            if (running_.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_lock_);
+            wake_.wait(lock, [this]() { return stop_ || running_.load(); });
+            if (stop_) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<TaskDeque>> deques_;
+    std::vector<std::thread> threads_;
+    std::mutex sleep_lock_;
+    std::condition_variable wake_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> root_done_{false};
+    bool stop_ = false;
+};
+
+#endif